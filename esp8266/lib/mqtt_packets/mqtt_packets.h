@@ -0,0 +1,217 @@
+// MQTT 3.1.1 packet encoders shared by the firmware and the mqtt_broker/ tools
+// - Header-only, no allocation, no STL containers; needs C++17 (ESP8266 core 3.x default)
+// - Packets whose bytes are fully known at compile time (CONNACK, PINGRESP, PUBLISH of a
+//   literal topic/payload pair) are constexpr arrays: sending one is a single memcpy/write
+// - Runtime encoders write into a caller buffer and return the byte count, or 0 if it does not fit
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace mqttpkt {
+
+// ---------- Packet types (first byte, including required flag bits) ----------
+static constexpr uint8_t CONNECT    = 0x10;
+static constexpr uint8_t CONNACK    = 0x20;
+static constexpr uint8_t PUBLISH    = 0x30;
+static constexpr uint8_t PUBACK     = 0x40;
+static constexpr uint8_t SUBSCRIBE  = 0x82;
+static constexpr uint8_t SUBACK     = 0x90;
+static constexpr uint8_t PINGREQ    = 0xC0;
+static constexpr uint8_t PINGRESP   = 0xD0;
+static constexpr uint8_t DISCONNECT = 0xE0;
+
+// ---------- Fixed packets ----------
+static constexpr uint8_t PINGREQ_PACKET[2]    = {PINGREQ, 0};
+static constexpr uint8_t PINGRESP_PACKET[2]   = {PINGRESP, 0};
+static constexpr uint8_t DISCONNECT_PACKET[2] = {DISCONNECT, 0};
+
+template <bool SessionPresent, uint8_t ReturnCode>
+struct Connack {
+    static constexpr uint8_t bytes[4] = {CONNACK, 2, SessionPresent ? 1 : 0, ReturnCode};
+};
+
+// ---------- Remaining length ----------
+constexpr size_t remainingLengthSize(size_t len) {
+    return len < 128 ? 1 : len < 16384 ? 2 : len < 2097152 ? 3 : 4;
+}
+
+inline size_t putRemainingLength(uint8_t* out, size_t len) {
+    size_t n = 0;
+    do {
+        uint8_t b = len % 128;
+        len /= 128;
+        if (len > 0) b |= 0x80;
+        out[n++] = b;
+    } while (len > 0);
+    return n;
+}
+
+// Decodes the fixed header at p. Returns its length, 0 if more bytes are needed, -1 if malformed.
+inline int decodeHeader(const uint8_t* p, size_t avail, size_t& remaining) {
+    remaining = 0;
+    size_t mult = 1;
+    for (int i = 1; i <= 4; ++i) {
+        if (size_t(i) >= avail) return 0;
+        remaining += (p[i] & 0x7F) * mult;
+        if ((p[i] & 0x80) == 0) return i + 1;
+        mult *= 128;
+    }
+    return -1;
+}
+
+// ---------- Acknowledgements (constant prefix, runtime packet id) ----------
+inline size_t encodePuback(uint8_t* out, uint16_t packetId) {
+    static constexpr uint8_t prefix[2] = {PUBACK, 2};
+    memcpy(out, prefix, sizeof(prefix));
+    out[2] = uint8_t(packetId >> 8);
+    out[3] = uint8_t(packetId);
+    return 4;
+}
+
+template <uint8_t GrantedQos>
+inline size_t encodeSuback(uint8_t* out, uint16_t packetId) {
+    static constexpr uint8_t bytes[5] = {SUBACK, 3, 0, 0, GrantedQos};
+    memcpy(out, bytes, sizeof(bytes));
+    out[2] = uint8_t(packetId >> 8);
+    out[3] = uint8_t(packetId);
+    return sizeof(bytes);
+}
+
+// ---------- PUBLISH ----------
+// Length-prefixed topic built at compile time: mqttpkt::topic("garage/door")
+template <size_t N>
+struct TopicField {
+    static constexpr size_t size = N + 1;  // 2 length bytes + N - 1 characters
+    uint8_t bytes[size];
+};
+
+template <size_t N>
+constexpr TopicField<N> topic(const char (&s)[N]) {
+    TopicField<N> t{};
+    t.bytes[0] = uint8_t((N - 1) >> 8);
+    t.bytes[1] = uint8_t(N - 1);
+    for (size_t i = 0; i + 1 < N; ++i) t.bytes[2 + i] = uint8_t(s[i]);
+    return t;
+}
+
+template <size_t N>
+inline size_t encodePublish(uint8_t* out, size_t cap, const TopicField<N>& t,
+                            const void* payload, size_t len, bool retain) {
+    size_t remaining = TopicField<N>::size + len;
+    size_t total = 1 + remainingLengthSize(remaining) + remaining;
+    if (total > cap) return 0;
+    out[0] = PUBLISH | (retain ? 1 : 0);
+    size_t pos = 1 + putRemainingLength(out + 1, remaining);
+    memcpy(out + pos, t.bytes, TopicField<N>::size);
+    memcpy(out + pos + TopicField<N>::size, payload, len);
+    return total;
+}
+
+// PUBLISH with a runtime topic: QoS 0, or QoS 1 when packetId is nonzero
+inline size_t encodePublish(uint8_t* out, size_t cap, const char* topic, size_t topicLen,
+                            const void* payload, size_t len, bool retain, uint16_t packetId = 0) {
+    size_t idLen = packetId ? 2 : 0;
+    size_t remaining = 2 + topicLen + idLen + len;
+    size_t total = 1 + remainingLengthSize(remaining) + remaining;
+    if (total > cap) return 0;
+    out[0] = PUBLISH | (packetId ? 0x02 : 0) | (retain ? 1 : 0);
+    size_t pos = 1 + putRemainingLength(out + 1, remaining);
+    out[pos++] = uint8_t(topicLen >> 8);
+    out[pos++] = uint8_t(topicLen);
+    memcpy(out + pos, topic, topicLen);
+    pos += topicLen;
+    if (packetId) {
+        out[pos++] = uint8_t(packetId >> 8);
+        out[pos++] = uint8_t(packetId);
+    }
+    memcpy(out + pos, payload, len);
+    return total;
+}
+
+// Whole QoS 0 PUBLISH of a literal topic and payload, e.g.
+//   static constexpr auto OPEN = mqttpkt::publishPacket("garage/door", "open", true);
+template <size_t T, size_t P>
+struct FixedPublish {
+    static constexpr size_t size = 2 + (T + 1) + (P - 1);
+    uint8_t bytes[size];
+};
+
+template <size_t T, size_t P>
+constexpr FixedPublish<T, P> publishPacket(const char (&t)[T], const char (&p)[P], bool retain) {
+    static_assert((T + 1) + (P - 1) < 128, "fixed PUBLISH must fit a one-byte remaining length");
+    FixedPublish<T, P> pkt{};
+    pkt.bytes[0] = PUBLISH | (retain ? 1 : 0);
+    pkt.bytes[1] = uint8_t((T + 1) + (P - 1));
+    TopicField<T> tf = topic(t);
+    for (size_t i = 0; i < TopicField<T>::size; ++i) pkt.bytes[2 + i] = tf.bytes[i];
+    for (size_t i = 0; i + 1 < P; ++i) pkt.bytes[2 + TopicField<T>::size + i] = uint8_t(p[i]);
+    return pkt;
+}
+
+// ---------- Runtime-string packets ----------
+inline size_t putString(uint8_t* out, const char* s, size_t len) {
+    out[0] = uint8_t(len >> 8);
+    out[1] = uint8_t(len);
+    memcpy(out + 2, s, len);
+    return len + 2;
+}
+
+// CONNECT for protocol level 4. user/pass and willTopic/willMsg may be null.
+inline size_t encodeConnect(uint8_t* out, size_t cap, const char* clientId, uint16_t keepAliveSec,
+                            bool cleanSession, const char* user = nullptr, const char* pass = nullptr,
+                            const char* willTopic = nullptr, const char* willMsg = nullptr,
+                            uint8_t willQos = 0, bool willRetain = false) {
+    static constexpr uint8_t protocol[7] = {0, 4, 'M', 'Q', 'T', 'T', 4};
+    size_t idLen = strlen(clientId);
+    size_t remaining = sizeof(protocol) + 1 + 2 + 2 + idLen;
+    uint8_t flags = cleanSession ? 0x02 : 0;
+    if (willTopic) {
+        remaining += 2 + strlen(willTopic) + 2 + strlen(willMsg);
+        flags |= 0x04 | uint8_t(willQos << 3) | (willRetain ? 0x20 : 0);
+    }
+    if (user) {
+        remaining += 2 + strlen(user);
+        flags |= 0x80;
+    }
+    if (pass) {
+        remaining += 2 + strlen(pass);
+        flags |= 0x40;
+    }
+    size_t total = 1 + remainingLengthSize(remaining) + remaining;
+    if (total > cap) return 0;
+
+    out[0] = CONNECT;
+    size_t pos = 1 + putRemainingLength(out + 1, remaining);
+    memcpy(out + pos, protocol, sizeof(protocol));
+    pos += sizeof(protocol);
+    out[pos++] = flags;
+    out[pos++] = uint8_t(keepAliveSec >> 8);
+    out[pos++] = uint8_t(keepAliveSec);
+    pos += putString(out + pos, clientId, idLen);
+    if (willTopic) {
+        pos += putString(out + pos, willTopic, strlen(willTopic));
+        pos += putString(out + pos, willMsg, strlen(willMsg));
+    }
+    if (user) pos += putString(out + pos, user, strlen(user));
+    if (pass) pos += putString(out + pos, pass, strlen(pass));
+    return pos;
+}
+
+inline size_t encodeSubscribe(uint8_t* out, size_t cap, uint16_t packetId,
+                              const char* filter, size_t filterLen, uint8_t qos) {
+    size_t remaining = 2 + 2 + filterLen + 1;
+    size_t total = 1 + remainingLengthSize(remaining) + remaining;
+    if (total > cap) return 0;
+    out[0] = SUBSCRIBE;
+    size_t pos = 1 + putRemainingLength(out + 1, remaining);
+    out[pos++] = uint8_t(packetId >> 8);
+    out[pos++] = uint8_t(packetId);
+    pos += putString(out + pos, filter, filterLen);
+    out[pos++] = qos;
+    return pos;
+}
+
+} // namespace mqttpkt
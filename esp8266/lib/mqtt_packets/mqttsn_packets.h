@@ -0,0 +1,66 @@
+// MQTT-SN 1.2 PUBLISH with pre-defined topic IDs, shared by the firmware and mqtt_broker/mqttsn_gateway
+// - QoS -1: no CONNECT, no session, no acknowledgement; one datagram per message
+// - Topic IDs are agreed in advance (firmware build flags, gateway topic file)
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace mqttsn {
+
+static constexpr uint8_t PUBLISH = 0x0C;
+
+// PUBLISH flags: DUP | QoS(2) | RETAIN | WILL | CLEAN | TOPIC_ID_TYPE(2)
+static constexpr uint8_t FLAG_QOS_MINUS1 = 0x60;
+static constexpr uint8_t FLAG_RETAIN = 0x10;
+static constexpr uint8_t TOPIC_PREDEFINED = 0x01;
+
+// Whole QoS -1 PUBLISH of a literal payload, e.g.
+//   static constexpr auto OPEN = mqttsn::publishPredefined(1, "open", true);
+template <size_t P>
+struct FixedPublish {
+    static constexpr size_t size = 7 + (P - 1);
+    uint8_t bytes[size];
+};
+
+template <size_t P>
+constexpr FixedPublish<P> publishPredefined(uint16_t topicId, const char (&payload)[P], bool retain) {
+    static_assert(7 + (P - 1) < 256, "fixed MQTT-SN PUBLISH must fit a one-byte length");
+    FixedPublish<P> pkt{};
+    pkt.bytes[0] = uint8_t(FixedPublish<P>::size);
+    pkt.bytes[1] = PUBLISH;
+    pkt.bytes[2] = FLAG_QOS_MINUS1 | (retain ? FLAG_RETAIN : 0) | TOPIC_PREDEFINED;
+    pkt.bytes[3] = uint8_t(topicId >> 8);
+    pkt.bytes[4] = uint8_t(topicId);
+    pkt.bytes[5] = 0;  // MsgId is unused at QoS -1
+    pkt.bytes[6] = 0;
+    for (size_t i = 0; i + 1 < P; ++i) pkt.bytes[7 + i] = uint8_t(payload[i]);
+    return pkt;
+}
+
+struct Publish {
+    uint8_t flags;
+    uint16_t topicId;
+    const uint8_t* data;
+    size_t len;
+};
+
+// Parses one datagram. Accepts the one-byte and the three-byte (0x01, hi, lo) length forms.
+inline bool parsePublish(const uint8_t* p, size_t n, Publish& out) {
+    size_t hdr = 1;
+    size_t len = n > 0 ? p[0] : 0;
+    if (len == 1) {
+        if (n < 3) return false;
+        len = (size_t(p[1]) << 8) | p[2];
+        hdr = 3;
+    }
+    if (len != n || n < hdr + 6 || p[hdr] != PUBLISH) return false;
+    out.flags = p[hdr + 1];
+    out.topicId = uint16_t((p[hdr + 2] << 8) | p[hdr + 3]);
+    out.data = p + hdr + 6;
+    out.len = n - hdr - 6;
+    return true;
+}
+
+} // namespace mqttsn
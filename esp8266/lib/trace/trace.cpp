@@ -0,0 +1,77 @@
+#include <Arduino.h>
+#include "trace.h"
+
+namespace {
+
+TraceRecord ring[TRACE_CAPACITY];
+uint16_t head = 0;      // next slot to write
+uint16_t count = 0;     // valid records, up to TRACE_CAPACITY
+uint32_t dropped = 0;   // overwritten records
+uint32_t lastWraps = 0; // micros64() >> 32 at the newest record
+
+TraceHeader makeHeader() {
+    TraceHeader h;
+    memcpy(h.magic, "GTR2", 4);
+    h.count = count;
+    h.recordSize = sizeof(TraceRecord);
+    h.dropped = dropped;
+    h.dumpedAtUs = micros();
+    return h;
+}
+
+// Calls emit(ptr, len) for the header and the records, oldest first
+template <typename Emit>
+void forEachChunk(Emit emit) {
+    TraceHeader h = makeHeader();
+    emit(reinterpret_cast<const uint8_t*>(&h), sizeof(h));
+    uint16_t start = (head + TRACE_CAPACITY - count) % TRACE_CAPACITY;
+    uint16_t first = count < TRACE_CAPACITY - start ? count : TRACE_CAPACITY - start;
+    emit(reinterpret_cast<const uint8_t*>(&ring[start]), first * sizeof(TraceRecord));
+    emit(reinterpret_cast<const uint8_t*>(&ring[0]), (count - first) * sizeof(TraceRecord));
+}
+
+void push(TraceEvent event, uint16_t arg, uint64_t now) {
+    TraceRecord& r = ring[head];
+    r.timestampUs = (uint32_t)now;
+    r.event = event;
+    r.wrap = (uint8_t)(now >> 32);
+    r.arg = arg;
+    head = (head + 1) % TRACE_CAPACITY;
+    if (count < TRACE_CAPACITY) {
+        ++count;
+    } else {
+        ++dropped;
+    }
+}
+
+} // namespace
+
+void traceRecord(TraceEvent event, uint16_t arg) {
+    uint64_t now = micros64();
+    uint32_t wraps = (uint32_t)(now >> 32);
+    // The wrap byte cannot tell 256 wraps apart: spell out longer gaps
+    uint32_t skipped = (wraps - lastWraps) >> 8;
+    if (count > 0 && skipped > 0) push(TRACE_EPOCH, skipped > 0xFFFF ? 0xFFFF : (uint16_t)skipped, now);
+    push(event, arg, now);
+    lastWraps = wraps;
+}
+
+size_t traceSize() {
+    return sizeof(TraceHeader) + count * sizeof(TraceRecord);
+}
+
+void traceWrite(Print& out) {
+    forEachChunk([&](const uint8_t* p, size_t len) { out.write(p, len); });
+}
+
+void traceWriteHex(Print& out) {
+    static const char HEX_DIGITS[] = "0123456789abcdef";
+    out.print("TRACE ");
+    forEachChunk([&](const uint8_t* p, size_t len) {
+        for (size_t i = 0; i < len; ++i) {
+            out.write(HEX_DIGITS[p[i] >> 4]);
+            out.write(HEX_DIGITS[p[i] & 0x0F]);
+        }
+    });
+    out.println();
+}
@@ -0,0 +1,19 @@
+// On-device binary event trace
+// - Fixed RAM ring of TraceRecord; recording is a micros64() call and four stores
+// - Dump raw (e.g. as an MQTT payload) or as one "TRACE <hex>" line on a text stream
+// - Decode on a host with mqtt_broker/trace_decode
+
+#pragma once
+
+#include <Print.h>
+#include "trace_format.h"
+
+static const uint16_t TRACE_CAPACITY = 256;  // 2 KiB of RAM
+
+void traceRecord(TraceEvent event, uint16_t arg = 0);
+
+// Bytes written by traceWrite(): header plus buffered records
+size_t traceSize();
+
+void traceWrite(Print& out);
+void traceWriteHex(Print& out);
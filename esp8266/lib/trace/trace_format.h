@@ -0,0 +1,53 @@
+// Binary trace format shared by the firmware ring and the host-side decoder
+// - Each record is 8 bytes: low 32 bits of the µs clock (micros64()), event id, the next 8 bits
+//   of the clock (counts micros() wraps, one per ~71.6 min) and an argument
+// - The decoder rebuilds the 64-bit clock from the wrap byte. Records more than 256 wraps
+//   (~12.7 days) apart get an EPOCH record in between that carries the skipped multiples of 256
+// - A dump is a 16-byte header followed by the records, oldest first; all fields little-endian
+
+#pragma once
+
+#include <stdint.h>
+
+// X(name, description of arg)
+#define TRACE_EVENTS(X)                                    \
+    X(BOOT,             "")                                \
+    X(DOOR_CHANGE,      "1 = open")                        \
+    X(WIFI_BEGIN,       "")                                \
+    X(WIFI_CONNECTED,   "ms since WIFI_BEGIN")             \
+    X(WIFI_FAILED,      "ms since WIFI_BEGIN")             \
+    X(MQTT_BEGIN,       "")                                \
+    X(MQTT_CONNECTED,   "ms since MQTT_BEGIN")             \
+    X(MQTT_FAILED,      "PubSubClient state, signed")      \
+    X(PUBLISH_OK,       "1 = open")                        \
+    X(PUBLISH_FAILED,   "1 = open")                        \
+    X(WINDOW_EXPIRED,   "")                                \
+    X(RADIO_SLEEP,      "")                                \
+    X(DUMP,             "0 = serial, 1 = mqtt")            \
+    X(EPOCH,            "x256 micros() wraps skipped")
+
+enum TraceEvent : uint8_t {
+#define TRACE_ENUM(name, arg) TRACE_##name,
+    TRACE_EVENTS(TRACE_ENUM)
+#undef TRACE_ENUM
+    TRACE_EVENT_COUNT
+};
+
+struct TraceRecord {
+    uint32_t timestampUs;  // micros64() bits 0-31
+    uint8_t event;
+    uint8_t wrap;          // micros64() bits 32-39
+    uint16_t arg;
+};
+
+struct TraceHeader {
+    char magic[4];        // "GTR2"
+    uint16_t count;       // records that follow
+    uint16_t recordSize;  // sizeof(TraceRecord)
+    uint32_t dropped;     // records overwritten since boot
+    uint32_t dumpedAtUs;  // micros() when the dump was taken
+};
+
+static_assert(TRACE_EVENT_COUNT <= 256, "event ids are stored in one byte");
+static_assert(sizeof(TraceRecord) == 8, "TraceRecord layout is part of the dump format");
+static_assert(sizeof(TraceHeader) == 16, "TraceHeader layout is part of the dump format");
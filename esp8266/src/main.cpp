@@ -1,10 +1,19 @@
 // Basic garage door monitor with on-demand Wi-Fi + MQTT
 // - Sends only the latest status ("open"/"closed") as retained message
 // - Keeps Wi-Fi on for a 10-minute window after sending; otherwise sleeps radio
+// - Build with -D USE_MQTTSN to publish over MQTT-SN/UDP through mqtt_broker/mqttsn_gateway
+//   instead: no TCP or CONNECT, one datagram per status right after association, then the
+//   radio sleeps again (no window). MQTT-SN is unauthenticated; see the gateway's --allow
 
 #include <ESP8266WiFi.h>
 #include <PubSubClient.h>
 #include "secrets.h"  // WIFI_SSID, WIFI_PASS, MQTT_HOST, MQTT_PORT, MQTT_USER, MQTT_PASS
+#include "mqtt_packets.h"
+#include "trace.h"
+#ifdef USE_MQTTSN
+#include <WiFiUdp.h>
+#include "mqttsn_packets.h"
+#endif
 
 // ---------- User-configurable pins and behavior ----------
 // Switch wiring: use internal pull-up, switch to GND.
@@ -16,9 +25,55 @@ static const unsigned long DEBOUNCE_MS = 80;
 // Connection window after a publish
 static const unsigned long WINDOW_MS = 10UL * 60UL * 1000UL; // 10 minutes
 
+// Minimum spacing between MQTT reconnects inside the window. Each CONNECT with our
+// client ID makes the broker take over (and tear down) the previous session.
+static const unsigned long RECONNECT_INTERVAL_MS = 2000;
+
 // Topics
-static const char* TOPIC_STATUS = "garage/door";           // retained: "open"/"closed"
-static const char* TOPIC_ONLINE = "garage/door/online";    // retained: "true"/"false"
+static constexpr char TOPIC_STATUS[] = "garage/door";           // retained: "open"/"closed"
+static constexpr char TOPIC_ONLINE[] = "garage/door/online";    // retained: "true"/"false"
+static constexpr char TOPIC_TRACE[] = "garage/door/trace";      // binary trace dump (not retained)
+static constexpr char TOPIC_TRACE_GET[] = "garage/door/trace/get"; // publish (not retained) to request a dump
+
+// Pre-encoded retained PUBLISH packets; sending one is a single write
+static constexpr auto PKT_ONLINE_TRUE = mqttpkt::publishPacket(TOPIC_ONLINE, "true", true);
+static constexpr auto PKT_STATUS_OPEN = mqttpkt::publishPacket(TOPIC_STATUS, "open", true);
+static constexpr auto PKT_STATUS_CLOSED = mqttpkt::publishPacket(TOPIC_STATUS, "closed", true);
+
+#ifdef USE_MQTTSN
+// Gateway UDP port and the topic IDs pre-registered in its topic file
+#ifndef MQTTSN_PORT
+#define MQTTSN_PORT 1884
+#endif
+#ifndef MQTTSN_TOPIC_STATUS
+#define MQTTSN_TOPIC_STATUS 1
+#endif
+#ifndef MQTTSN_TOPIC_ONLINE
+#define MQTTSN_TOPIC_ONLINE 2
+#endif
+// Extra copies of each status datagram, MQTTSN_REPEAT_MS apart, against single-frame loss
+#ifndef MQTTSN_REPEATS
+#define MQTTSN_REPEATS 0
+#endif
+#ifndef MQTTSN_REPEAT_MS
+#define MQTTSN_REPEAT_MS 30
+#endif
+// Sends of a status per wake-up before giving up (MQTTSN_REPEAT_MS apart), and how long the
+// radio then stays off before the next wake-up tries again
+#ifndef MQTTSN_SEND_ATTEMPTS
+#define MQTTSN_SEND_ATTEMPTS 3
+#endif
+#ifndef MQTTSN_RETRY_MS
+#define MQTTSN_RETRY_MS 10000
+#endif
+// Time for the last frame to leave the radio before it is switched off
+static const unsigned long MQTTSN_TX_DRAIN_MS = 5;
+
+// QoS -1 PUBLISH datagrams; the gateway republishes them retained under the mapped topic
+static constexpr auto SN_ONLINE_TRUE = mqttsn::publishPredefined(MQTTSN_TOPIC_ONLINE, "true", true);
+static constexpr auto SN_STATUS_OPEN = mqttsn::publishPredefined(MQTTSN_TOPIC_STATUS, "open", true);
+static constexpr auto SN_STATUS_CLOSED = mqttsn::publishPredefined(MQTTSN_TOPIC_STATUS, "closed", true);
+#endif
 
 // Publish on boot so the broker has a correct retained state
 static const bool PUBLISH_ON_BOOT = true;
@@ -26,6 +81,11 @@ static const bool PUBLISH_ON_BOOT = true;
 // ---------- Globals ----------
 WiFiClient wifi;
 PubSubClient mqtt(wifi);
+#ifdef USE_MQTTSN
+WiFiUDP udp;
+bool snOnlineSent = false;  // no LWT over MQTT-SN, so online "true" is sent once per boot
+unsigned long snRetryAt = 0;  // after a failed send: no wake-up before this (0 = none pending)
+#endif
 
 // Status tracking
 bool lastStable = false;           // stable logical state (true=open)
@@ -35,9 +95,19 @@ unsigned long lastBounceAt = 0;    // last time the raw read changed
 // Dirty flag: there is an unsent latest status
 bool dirty = false;
 
+// Last status the broker retained from us (-1 = unknown, e.g. after boot).
+// A dirty status equal to this is dropped instead of republished.
+int8_t lastPublished = -1;
+
 // Window: remain connected until deadline, then sleep Wi-Fi if no pending data
 unsigned long windowDeadline = 0;
 
+// Last in-window reconnect attempt
+unsigned long lastReconnectAt = 0;
+
+// Set from the MQTT callback; the dump is published from loop()
+bool traceRequested = false;
+
 // Helpers to map pin to logical "open"/"closed"
 inline bool readLogical() {
     int v = digitalRead(SWITCH_PIN);
@@ -52,6 +122,7 @@ inline const char* statusString(bool logicalOpen) {
 
 // ---------- Wi-Fi radio control ----------
 void wifiRadioSleep() {
+    traceRecord(TRACE_RADIO_SLEEP);
     mqtt.disconnect();
     WiFi.disconnect(true);
     WiFi.persistent(false);
@@ -62,6 +133,7 @@ void wifiRadioSleep() {
 
 bool wifiEnsureConnected(unsigned long timeoutMs) {
     if (WiFi.status() == WL_CONNECTED) return true;
+    traceRecord(TRACE_WIFI_BEGIN);
     WiFi.forceSleepWake();
     delay(1);
     WiFi.mode(WIFI_STA);
@@ -74,10 +146,16 @@ bool wifiEnsureConnected(unsigned long timeoutMs) {
         delay(50);
         yield();
     }
-    return WiFi.status() == WL_CONNECTED;
+    bool ok = WiFi.status() == WL_CONNECTED;
+    traceRecord(ok ? TRACE_WIFI_CONNECTED : TRACE_WIFI_FAILED, millis() - start);
+    return ok;
 }
 
 // ---------- MQTT ----------
+void mqttCallback(char* topic, byte*, unsigned int) {
+    if (strcmp(topic, TOPIC_TRACE_GET) == 0) traceRequested = true;
+}
+
 String makeClientId() {
 #ifdef DEVICE_ID
     return String("esp-") + String(DEVICE_ID);
@@ -86,6 +164,24 @@ String makeClientId() {
 #endif
 }
 
+// ---------- Status packets ----------
+// Appends the retained status PUBLISH to buf, returns its length
+size_t appendStatus(uint8_t* buf, bool logicalOpen) {
+    if (logicalOpen) {
+        memcpy(buf, PKT_STATUS_OPEN.bytes, PKT_STATUS_OPEN.size);
+        return PKT_STATUS_OPEN.size;
+    }
+    memcpy(buf, PKT_STATUS_CLOSED.bytes, PKT_STATUS_CLOSED.size);
+    return PKT_STATUS_CLOSED.size;
+}
+
+void statusSent(bool logicalOpen) {
+    traceRecord(TRACE_PUBLISH_OK, logicalOpen);
+    windowDeadline = millis() + WINDOW_MS; // extend window
+    dirty = false;
+    lastPublished = logicalOpen;
+}
+
 bool mqttConnect() {
     mqtt.setServer(MQTT_HOST, MQTT_PORT);
     String cid = makeClientId();
@@ -96,6 +192,8 @@ bool mqttConnect() {
     bool willRetain = true;
     uint8_t willQos = 0;
 
+    traceRecord(TRACE_MQTT_BEGIN);
+    unsigned long started = millis();
     bool ok;
     if (strlen(MQTT_USER) > 0 || strlen(MQTT_PASS) > 0) {
         ok = mqtt.connect(cid.c_str(), MQTT_USER, MQTT_PASS, willTopic, willQos, willRetain, willMsg);
@@ -104,24 +202,103 @@ bool mqttConnect() {
     }
 
     if (ok) {
-        // We are online
-        mqtt.publish(TOPIC_ONLINE, "true", true);
+        traceRecord(TRACE_MQTT_CONNECTED, millis() - started);
+        Serial.print("MQTT: connected in ");
+        Serial.print(millis() - started);
+        Serial.println(" ms");
+
+        // Everything that follows CONNACK goes out in one write (one TCP segment):
+        // online "true", the trace-request subscription and the pending status, if any
+        uint8_t burst[128];
+        memcpy(burst, PKT_ONLINE_TRUE.bytes, PKT_ONLINE_TRUE.size);
+        size_t len = PKT_ONLINE_TRUE.size;
+        len += mqttpkt::encodeSubscribe(burst + len, sizeof(burst) - len, 1, TOPIC_TRACE_GET, strlen(TOPIC_TRACE_GET), 0);
+        bool status = lastStable;
+        bool sendStatus = dirty && lastPublished != (int8_t)status;
+        if (sendStatus) len += appendStatus(burst + len, status);
+
+        bool sent = mqtt.write(burst, len) == len;
+        if (sendStatus) {
+            if (sent) {
+                statusSent(status);
+            } else {
+                traceRecord(TRACE_PUBLISH_FAILED, status);
+            }
+        }
+    } else {
+        // Negative states (-4..-1) go in as int16_t bits; trace_decode prints this arg signed
+        traceRecord(TRACE_MQTT_FAILED, (uint16_t)(int16_t)mqtt.state());
     }
     return ok;
 }
 
 bool publishStatus(bool logicalOpen) {
-    const char* payload = statusString(logicalOpen);
-    bool ok = mqtt.publish(TOPIC_STATUS, payload, true);
+    uint8_t pkt[PKT_STATUS_CLOSED.size];
+    size_t len = appendStatus(pkt, logicalOpen);
+    bool ok = mqtt.connected() && mqtt.write(pkt, len) == len;
     if (ok) {
-        windowDeadline = millis() + WINDOW_MS; // extend window
-        dirty = false;
+        statusSent(logicalOpen);
+    } else {
+        traceRecord(TRACE_PUBLISH_FAILED, logicalOpen);
     }
     return ok;
 }
 
+#ifdef USE_MQTTSN
+// ---------- MQTT-SN ----------
+bool snSend(const uint8_t* pkt, size_t len) {
+    return udp.beginPacket(MQTT_HOST, MQTTSN_PORT) && udp.write(pkt, len) == len && udp.endPacket();
+}
+
+bool snSendStatus(bool logicalOpen) {
+    if (logicalOpen) return snSend(SN_STATUS_OPEN.bytes, SN_STATUS_OPEN.size);
+    return snSend(SN_STATUS_CLOSED.bytes, SN_STATUS_CLOSED.size);
+}
+
+// QoS -1 has no session, so there is no LWT: online "true" goes out once per boot and
+// stays retained. The status is one datagram with no acknowledgement; nothing comes back,
+// so the radio goes to sleep as soon as it has left. A send that keeps failing also ends
+// with the radio asleep: the status stays dirty and is retried after MQTTSN_RETRY_MS.
+bool snPublishStatus(bool logicalOpen) {
+    if (!snOnlineSent) snOnlineSent = snSend(SN_ONLINE_TRUE.bytes, SN_ONLINE_TRUE.size);
+    bool ok = snSendStatus(logicalOpen);
+    for (int i = 1; !ok && i < MQTTSN_SEND_ATTEMPTS; ++i) {
+        delay(MQTTSN_REPEAT_MS);
+        ok = snSendStatus(logicalOpen);
+    }
+    if (ok) {
+        snRetryAt = 0;
+        statusSent(logicalOpen);
+        for (int i = 0; i < MQTTSN_REPEATS; ++i) {
+            delay(MQTTSN_REPEAT_MS);
+            snSendStatus(logicalOpen);
+        }
+    } else {
+        traceRecord(TRACE_PUBLISH_FAILED, logicalOpen);
+        snRetryAt = millis() + MQTTSN_RETRY_MS;
+        if (snRetryAt == 0) snRetryAt = 1;
+    }
+    delay(MQTTSN_TX_DRAIN_MS);
+    wifiRadioSleep();
+    return ok;
+}
+#endif
+
 void ensureMqttAndPublishIfDirty() {
     if (!dirty) return;
+    if (lastPublished == (int8_t)lastStable) {
+        // Door went back to the state the broker already has: nothing to send. A failed
+        // connect may have left Wi-Fi up with no session or window to close it; sleep it here.
+        dirty = false;
+        if (WiFi.status() == WL_CONNECTED &&
+            (!mqtt.connected() || (long)(millis() - windowDeadline) >= 0)) {
+            wifiRadioSleep();
+        }
+        return;
+    }
+#ifdef USE_MQTTSN
+    if (snRetryAt != 0 && (long)(millis() - snRetryAt) < 0) return; // radio off until the retry
+#endif
     if (WiFi.status() != WL_CONNECTED) {
         Serial.println("WiFi: connecting...");
     }
@@ -129,12 +306,27 @@ void ensureMqttAndPublishIfDirty() {
         Serial.println("WiFi: connect failed");
         return; // short Wi-Fi attempt
     }
+#ifdef USE_MQTTSN
+    if (snPublishStatus(lastStable)) {
+        Serial.print("MQTT-SN: published status = ");
+        Serial.println(statusString(lastStable));
+    } else {
+        Serial.println("MQTT-SN: send failed, retrying later");
+    }
+    return;
+#endif
     if (!mqtt.connected()) {
         Serial.println("MQTT: connecting...");
         if (!mqttConnect()) {
             Serial.println("MQTT: connect failed");
             return;
         }
+        if (!dirty) {
+            // Status went out together with the connect burst
+            Serial.print("MQTT: published status = ");
+            Serial.println(statusString(lastStable));
+            return;
+        }
     }
     if (publishStatus(lastStable)) {
         Serial.print("MQTT: published status = ");
@@ -144,13 +336,22 @@ void ensureMqttAndPublishIfDirty() {
     }
 }
 
+void publishTrace() {
+    traceRecord(TRACE_DUMP, 1);
+    mqtt.beginPublish(TOPIC_TRACE, traceSize(), false);
+    traceWrite(mqtt);
+    mqtt.endPublish();
+}
+
 void setup() {
+    traceRecord(TRACE_BOOT);
     Serial.begin(115200);
     delay(10);
     Serial.println();
     Serial.println("Garage monitor starting...");
 
     pinMode(SWITCH_PIN, INPUT_PULLUP);
+    mqtt.setCallback(mqttCallback);
 
     // Initialize state from current reading
     lastRead = lastStable = readLogical();
@@ -175,27 +376,43 @@ void loop() {
     if ((millis() - lastBounceAt) >= DEBOUNCE_MS && lastStable != lastRead) {
         lastStable = lastRead;
         dirty = true; // new status to send
+        traceRecord(TRACE_DOOR_CHANGE, lastStable);
         Serial.print("door: ");
         Serial.println(statusString(lastStable));
     }
 
+    // Send 't' on the serial console to dump the trace ring as a hex line
+    if (Serial.available() > 0 && Serial.read() == 't') {
+        traceRecord(TRACE_DUMP, 0);
+        traceWriteHex(Serial);
+    }
+
     // 2) If we have unsent status, connect on-demand and send
     ensureMqttAndPublishIfDirty();
 
     // 3) Maintain connection during the window
+#ifndef USE_MQTTSN
     if (mqtt.connected()) {
         mqtt.loop();
+        if (traceRequested) {
+            traceRequested = false;
+            publishTrace();
+        }
         if (!dirty && (long)(millis() - windowDeadline) >= 0) {
+            traceRecord(TRACE_WINDOW_EXPIRED);
             Serial.println("Window expired. Sleeping Wi-Fi.");
             wifiRadioSleep();
         }
     } else {
         // If Wi-Fi is still connected but MQTT dropped during window, try reconnect quickly
-        if ((WiFi.status() == WL_CONNECTED) && (windowDeadline != 0) && (millis() <= windowDeadline)) {
+        if ((WiFi.status() == WL_CONNECTED) && (windowDeadline != 0) && (millis() <= windowDeadline) &&
+            (millis() - lastReconnectAt) >= RECONNECT_INTERVAL_MS) {
+            lastReconnectAt = millis();
             Serial.println("MQTT: reconnecting during window...");
             mqttConnect();
         }
     }
+#endif
 
     delay(10);
 }
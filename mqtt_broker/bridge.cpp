@@ -0,0 +1,475 @@
+// Site-to-central MQTT bridge
+// - Subscribes to selected topics on the local (site) broker and republishes them upstream
+// - Each batch read from the local broker goes upstream as one write, at QoS 1 with a bounded
+//   in-flight window
+// - State topics (--state): latest value per topic only, always republished retained, so a backlog
+//   or an outage collapses to one message per device
+// - Event topics (--event): forwarded in order with their retain flag
+// - The upstream connection never blocks the local ones: connect is bounded, sends the socket does
+//   not take are queued, and a missing PINGRESP (1.5x --keepalive) counts as an outage
+// - Whatever cannot go upstream is spooled: events appended to FILE, states rewritten to
+//   FILE.state with one record per topic. The spool is truncated only once every spooled message
+//   has been PUBACKed; a restarted bridge picks it up again. Events beyond --spool-max-mb are
+//   dropped. Messages in flight when the connection drops are requeued and spooled; only a crash
+//   while they are in flight loses them (states come back from the local broker's retained copy)
+// - The client ID defaults to "bridge-<hostname>" so bridges at different sites do not take over
+//   each other's session at the central broker; --user/--pass authenticate upstream,
+//   --local-user/--local-pass at the site broker
+//
+// Usage: bridge --remote HOST [--remote-port 1883] [--local HOST] [--local-port 1883]
+//               [--state FILTER]... [--event FILTER]... [--prefix P] [--spool FILE]
+//               [--spool-max-mb 64] [--keepalive 60] [--client-id ID] [--user U] [--pass P]
+//               [--local-user U] [--local-pass P]
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <poll.h>
+#include <unistd.h>
+
+#include "../esp8266/lib/mqtt_packets/mqtt_packets.h"
+#include "subscriber.h"
+
+namespace {
+
+struct Config {
+    std::string local = "127.0.0.1";
+    uint16_t localPort = 1883;
+    std::string remote;
+    uint16_t remotePort = 1883;
+    std::vector<std::string> stateFilters;
+    std::vector<std::string> eventFilters;
+    std::string prefix;
+    std::string spool;
+    size_t spoolMaxBytes = 64u << 20;
+    uint16_t keepAliveSec = 60;
+    std::string clientId;  // empty: "bridge-<hostname>"
+    std::string user;
+    std::string pass;
+    std::string localUser;
+    std::string localPass;
+};
+
+struct Entry {
+    std::string topic;
+    std::string payload;
+    bool retain;
+    bool state;
+};
+
+struct Inflight {
+    uint16_t id;
+    Entry entry;
+    bool fromSpool;
+    bool acked;
+};
+
+// Unacknowledged QoS 1 publishes upstream; beyond this messages wait in the pending queue
+const size_t MAX_INFLIGHT = 256;
+
+// Spool record: u8 flags, u16 topic length, u32 payload length, topic, payload (little-endian)
+const uint8_t SPOOL_RETAIN = 0x01;
+const uint8_t SPOOL_STATE = 0x02;
+
+uint64_t nowMs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000 + uint64_t(ts.tv_nsec) / 1000000;
+}
+
+void writeRecord(std::FILE* f, const Entry& e) {
+    uint8_t hdr[7];
+    hdr[0] = uint8_t((e.retain ? SPOOL_RETAIN : 0) | (e.state ? SPOOL_STATE : 0));
+    uint16_t tl = uint16_t(e.topic.size());
+    uint32_t pl = uint32_t(e.payload.size());
+    std::memcpy(hdr + 1, &tl, 2);
+    std::memcpy(hdr + 3, &pl, 4);
+    std::fwrite(hdr, 1, sizeof(hdr), f);
+    std::fwrite(e.topic.data(), 1, e.topic.size(), f);
+    std::fwrite(e.payload.data(), 1, e.payload.size(), f);
+}
+
+class Bridge {
+public:
+    explicit Bridge(const Config& cfg)
+        : cfg_(cfg), states_(cfg.clientId + "-state"), events_(cfg.clientId + "-events"),
+          upstream_(cfg.clientId) {
+        states_.setConflate(true);
+        upstream_.setAckHandler([this](uint16_t id) { onAck(id); });
+        loadSpool(cfg_.spool);
+        loadSpool(statePath());
+    }
+
+    ~Bridge() {
+        if (spool_) std::fclose(spool_);
+    }
+
+    void run() {
+        for (;;) {
+            uint64_t now = nowMs();
+            if (!upstream_.connected() && now >= nextUpstreamMs_) connectUpstream();
+            if ((!states_.connected() || !events_.connected()) && now >= nextLocalMs_) connectLocal();
+
+            pollfd fds[3];
+            nfds_t n = 0;
+            if (states_.connected()) fds[n++] = pollfd{states_.fd(), POLLIN, 0};
+            if (events_.connected()) fds[n++] = pollfd{events_.fd(), POLLIN, 0};
+            if (upstream_.connected()) {
+                fds[n++] = pollfd{upstream_.fd(), short(POLLIN | (upstream_.queuedBytes() ? POLLOUT : 0)), 0};
+            }
+            if (::poll(fds, n, 1000) < 0 && errno != EINTR) {
+                std::perror("poll");
+                return;
+            }
+
+            // poll(0) also sends keep-alives, flushes queued sends and drains PINGRESP/PUBACK
+            if (upstream_.connected()) {
+                if (!upstream_.poll(0, [](const garage::Message*, size_t) {})) {
+                    upstreamLost("upstream connection lost");
+                } else if (acked_) {
+                    acked_ = false;
+                    retireAcked();
+                }
+            }
+            if (states_.connected()) states_.poll(0, [this](const garage::Message* m, size_t c) { forward(m, c, true); });
+            if (events_.connected()) events_.poll(0, [this](const garage::Message* m, size_t c) { forward(m, c, false); });
+        }
+    }
+
+private:
+    void connectUpstream() {
+        if (!upstream_.connect(cfg_.remote, cfg_.remotePort, cfg_.keepAliveSec, cfg_.user, cfg_.pass)) {
+            nextUpstreamMs_ = nowMs() + upstreamBackoffMs_;
+            upstreamBackoffMs_ = upstreamBackoffMs_ < 30000 ? upstreamBackoffMs_ * 2 : 30000;
+            return;
+        }
+        std::fprintf(stderr, "upstream connected to %s:%u\n", cfg_.remote.c_str(), cfg_.remotePort);
+        upstreamBackoffMs_ = 1000;
+        if (pendingCount() > 0) {
+            std::fprintf(stderr, "replaying %zu state topics, %zu events (%llu events dropped)\n",
+                         pendingStates_.size(), pendingEvents_.size(), (unsigned long long)droppedEvents_);
+            droppedEvents_ = 0;
+        }
+        out_.clear();
+        fillWindow();
+        sendOut();
+    }
+
+    void connectLocal() {
+        bool ok = true;
+        if (!states_.connected() && !cfg_.stateFilters.empty()) {
+            ok = states_.connect(cfg_.local, cfg_.localPort, cfg_.keepAliveSec, cfg_.localUser, cfg_.localPass);
+            for (const std::string& f : cfg_.stateFilters) ok = ok && states_.subscribe(f);
+        }
+        if (!events_.connected() && !cfg_.eventFilters.empty()) {
+            bool e = events_.connect(cfg_.local, cfg_.localPort, cfg_.keepAliveSec, cfg_.localUser, cfg_.localPass);
+            for (const std::string& f : cfg_.eventFilters) e = e && events_.subscribe(f);
+            ok = ok && e;
+        }
+        nextLocalMs_ = nowMs() + (ok ? 0 : 2000);
+    }
+
+    std::string upstreamTopic(std::string_view topic) const {
+        std::string t = cfg_.prefix;
+        t.append(topic.data(), topic.size());
+        return t;
+    }
+
+    size_t pendingCount() const { return pendingStates_.size() + pendingEvents_.size(); }
+
+    // ---------- Upstream ----------
+    void forward(const garage::Message* msgs, size_t count, bool state) {
+        out_.clear();
+        for (size_t i = 0; i < count; ++i) {
+            Entry e{upstreamTopic(msgs[i].topic), std::string(msgs[i].payload), state || msgs[i].retained, state};
+            // Straight upstream only when nothing older is waiting, so events stay in order
+            if (upstream_.connected() && pendingCount() == 0 && inflight_.size() < MAX_INFLIGHT) {
+                publish(std::move(e), false);
+            } else {
+                enqueue(std::move(e), true);
+            }
+        }
+        sendOut();
+        syncSpool();
+    }
+
+    void publish(Entry e, bool fromSpool) {
+        uint16_t id = nextPacketId_++;
+        if (nextPacketId_ == 0) nextPacketId_ = 1;
+        size_t at = out_.size();
+        out_.resize(at + 10 + e.topic.size() + e.payload.size());
+        size_t used = mqttpkt::encodePublish(out_.data() + at, out_.size() - at, e.topic.data(), e.topic.size(),
+                                             e.payload.data(), e.payload.size(), e.retain, id);
+        out_.resize(at + used);
+        if (fromSpool) ++spooledInflight_;
+        inflight_.push_back(Inflight{id, std::move(e), fromSpool, false});
+    }
+
+    // Moves pending messages into the in-flight window: events in order, then states
+    void fillWindow() {
+        while (inflight_.size() < MAX_INFLIGHT && !pendingEvents_.empty()) {
+            pendingEventBytes_ -= pendingEvents_.front().topic.size() + pendingEvents_.front().payload.size();
+            publish(std::move(pendingEvents_.front()), true);
+            pendingEvents_.pop_front();
+        }
+        while (inflight_.size() < MAX_INFLIGHT && !pendingStates_.empty()) {
+            auto it = pendingStates_.begin();
+            publish(Entry{it->first, std::move(it->second), true, true}, true);
+            pendingStates_.erase(it);
+        }
+    }
+
+    void sendOut() {
+        if (out_.empty() || !upstream_.connected()) return;
+        if (!upstream_.sendPackets(out_.data(), out_.size())) upstreamLost("upstream write failed");
+        out_.clear();
+    }
+
+    // Runs inside upstream_.poll(): only marks, the window moves once poll() has returned
+    void onAck(uint16_t id) {
+        for (Inflight& f : inflight_) {
+            if (f.id == id && !f.acked) {
+                f.acked = true;
+                acked_ = true;
+                return;
+            }
+        }
+    }
+
+    void retireAcked() {
+        while (!inflight_.empty() && inflight_.front().acked) {
+            if (inflight_.front().fromSpool) --spooledInflight_;
+            inflight_.pop_front();
+        }
+        out_.clear();
+        fillWindow();
+        sendOut();
+        syncSpool();
+    }
+
+    // Requeues everything unacknowledged in front of the pending messages and spools it
+    void upstreamLost(const char* why) {
+        std::fprintf(stderr, "%s, spooling\n", why);
+        upstream_.close();
+        for (size_t i = inflight_.size(); i-- > 0;) {
+            Inflight& f = inflight_[i];
+            if (f.acked) continue;
+            if (f.entry.state) {
+                pendingStates_.emplace(std::move(f.entry.topic), std::move(f.entry.payload));  // newer value wins
+            } else {
+                pendingEventBytes_ += f.entry.topic.size() + f.entry.payload.size();
+                pendingEvents_.push_front(std::move(f.entry));
+            }
+        }
+        inflight_.clear();
+        spooledInflight_ = 0;
+        statesDirty_ = true;
+        rewriteEvents();
+        syncSpool();
+    }
+
+    void enqueue(Entry e, bool persist) {
+        if (!e.state && pendingEventBytes_ + e.topic.size() + e.payload.size() > cfg_.spoolMaxBytes) {
+            ++droppedEvents_;
+            return;
+        }
+        if (e.state) {
+            statesDirty_ = statesDirty_ || persist;
+            pendingStates_[std::move(e.topic)] = std::move(e.payload);
+        } else {
+            if (persist && openSpool()) {
+                writeRecord(spool_, e);
+                ++spoolEventRecords_;
+            }
+            pendingEventBytes_ += e.topic.size() + e.payload.size();
+            pendingEvents_.push_back(std::move(e));
+        }
+    }
+
+    // ---------- Spool ----------
+    // FILE holds events (appended), FILE.state one record per state topic (rewritten). Together
+    // they cover the pending queue plus spooled messages still in flight.
+    std::string statePath() const { return cfg_.spool.empty() ? std::string() : cfg_.spool + ".state"; }
+
+    bool openSpool() {
+        if (spool_ || cfg_.spool.empty()) return spool_ != nullptr;
+        spool_ = std::fopen(cfg_.spool.c_str(), "ab");
+        if (!spool_) std::perror(cfg_.spool.c_str());
+        return spool_ != nullptr;
+    }
+
+    void syncSpool() {
+        if (cfg_.spool.empty()) return;
+        if (pendingCount() == 0 && spooledInflight_ == 0) {
+            if (spoolEventRecords_ == 0 && !statesOnDisk_) return;
+            if (spool_) std::fclose(spool_);
+            spool_ = nullptr;
+            if (truncate(cfg_.spool.c_str(), 0) != 0 && errno != ENOENT) std::perror("spool truncate");
+            if (unlink(statePath().c_str()) != 0 && errno != ENOENT) std::perror("spool unlink");
+            spoolEventRecords_ = 0;
+            statesOnDisk_ = statesDirty_ = false;
+            std::fprintf(stderr, "spool acknowledged upstream, truncated\n");
+            return;
+        }
+        if (spool_) std::fflush(spool_);
+        // Acknowledged events stay in FILE until it drains; compact once they dominate it
+        if (spoolEventRecords_ > 2 * (pendingEvents_.size() + spooledInflight_) + 1024) rewriteEvents();
+        if (statesDirty_) rewriteStates();
+    }
+
+    // Writes a spool file atomically: a crash leaves either the old or the new file
+    template <typename Fn>
+    bool replaceFile(const std::string& path, Fn write) {
+        std::string tmp = path + ".tmp";
+        std::FILE* f = std::fopen(tmp.c_str(), "wb");
+        if (!f) {
+            std::perror(tmp.c_str());
+            return false;
+        }
+        write(f);
+        bool ok = std::fflush(f) == 0 && fsync(fileno(f)) == 0;
+        ok = std::fclose(f) == 0 && ok;
+        if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+            std::perror(path.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    void rewriteEvents() {
+        if (cfg_.spool.empty()) return;
+        if (spool_) std::fclose(spool_);
+        spool_ = nullptr;
+        size_t records = 0;
+        bool ok = replaceFile(cfg_.spool, [&](std::FILE* f) {
+            for (const Inflight& i : inflight_) {
+                if (i.fromSpool && !i.acked && !i.entry.state) writeRecord(f, i.entry), ++records;
+            }
+            for (const Entry& e : pendingEvents_) writeRecord(f, e), ++records;
+        });
+        if (ok) spoolEventRecords_ = records;
+    }
+
+    void rewriteStates() {
+        size_t records = 0;
+        bool ok = replaceFile(statePath(), [&](std::FILE* f) {
+            for (const Inflight& i : inflight_) {
+                if (i.fromSpool && !i.acked && i.entry.state && !pendingStates_.count(i.entry.topic)) {
+                    writeRecord(f, i.entry), ++records;
+                }
+            }
+            for (const auto& [topic, payload] : pendingStates_) {
+                writeRecord(f, Entry{topic, payload, true, true}), ++records;
+            }
+        });
+        if (ok) {
+            statesDirty_ = false;
+            statesOnDisk_ = records > 0;
+        }
+    }
+
+    // A torn last record (crash mid-write) ends the replay
+    void loadSpool(const std::string& path) {
+        if (path.empty()) return;
+        std::FILE* f = std::fopen(path.c_str(), "rb");
+        if (!f) return;
+        size_t loaded = 0;
+        uint8_t hdr[7];
+        while (std::fread(hdr, 1, sizeof(hdr), f) == sizeof(hdr)) {
+            uint16_t tl;
+            uint32_t pl;
+            std::memcpy(&tl, hdr + 1, 2);
+            std::memcpy(&pl, hdr + 3, 4);
+            Entry e{std::string(tl, '\0'), std::string(pl, '\0'), (hdr[0] & SPOOL_RETAIN) != 0,
+                    (hdr[0] & SPOOL_STATE) != 0};
+            if (std::fread(e.topic.data(), 1, tl, f) != tl || std::fread(e.payload.data(), 1, pl, f) != pl) break;
+            if (e.state) statesOnDisk_ = true;
+            else ++spoolEventRecords_;
+            enqueue(std::move(e), false);
+            ++loaded;
+        }
+        std::fclose(f);
+        if (loaded > 0) std::fprintf(stderr, "loaded %zu spooled messages from %s\n", loaded, path.c_str());
+    }
+
+    const Config& cfg_;
+    garage::Subscriber states_;
+    garage::Subscriber events_;
+    garage::Subscriber upstream_;  // publish-only; poll() keeps it alive and reads PUBACKs
+    uint64_t nextUpstreamMs_ = 0;
+    uint64_t upstreamBackoffMs_ = 1000;
+    uint64_t nextLocalMs_ = 0;
+
+    std::vector<uint8_t> out_;
+    std::deque<Inflight> inflight_;  // in publish order
+    uint16_t nextPacketId_ = 1;
+    size_t spooledInflight_ = 0;     // unacknowledged in-flight messages that came from the spool
+    bool acked_ = false;
+
+    std::unordered_map<std::string, std::string> pendingStates_;  // newest payload per topic
+    std::deque<Entry> pendingEvents_;
+    size_t pendingEventBytes_ = 0;
+    uint64_t droppedEvents_ = 0;
+
+    std::FILE* spool_ = nullptr;     // FILE, open for append
+    size_t spoolEventRecords_ = 0;   // records in FILE, including already acknowledged ones
+    bool statesDirty_ = false;       // FILE.state is behind pendingStates_
+    bool statesOnDisk_ = false;
+};
+
+bool parseArgs(int argc, char** argv, Config& cfg) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char* k = argv[i];
+        const char* v = argv[i + 1];
+        if (!std::strcmp(k, "--local")) cfg.local = v;
+        else if (!std::strcmp(k, "--local-port")) cfg.localPort = uint16_t(std::strtoul(v, nullptr, 10));
+        else if (!std::strcmp(k, "--remote")) cfg.remote = v;
+        else if (!std::strcmp(k, "--remote-port")) cfg.remotePort = uint16_t(std::strtoul(v, nullptr, 10));
+        else if (!std::strcmp(k, "--state")) cfg.stateFilters.push_back(v);
+        else if (!std::strcmp(k, "--event")) cfg.eventFilters.push_back(v);
+        else if (!std::strcmp(k, "--prefix")) cfg.prefix = v;
+        else if (!std::strcmp(k, "--spool")) cfg.spool = v;
+        else if (!std::strcmp(k, "--spool-max-mb")) cfg.spoolMaxBytes = size_t(std::strtoul(v, nullptr, 10)) << 20;
+        else if (!std::strcmp(k, "--keepalive")) cfg.keepAliveSec = uint16_t(std::strtoul(v, nullptr, 10));
+        else if (!std::strcmp(k, "--client-id")) cfg.clientId = v;
+        else if (!std::strcmp(k, "--user")) cfg.user = v;
+        else if (!std::strcmp(k, "--pass")) cfg.pass = v;
+        else if (!std::strcmp(k, "--local-user")) cfg.localUser = v;
+        else if (!std::strcmp(k, "--local-pass")) cfg.localPass = v;
+        else return false;
+    }
+    if (cfg.clientId.empty()) {
+        char host[256] = {};
+        if (gethostname(host, sizeof(host) - 1) != 0 || !host[0]) {
+            std::fprintf(stderr, "bridge: no hostname, pass --client-id\n");
+            return false;
+        }
+        cfg.clientId = std::string("bridge-") + host;
+    }
+    return argc % 2 == 1 && !cfg.remote.empty() && (!cfg.stateFilters.empty() || !cfg.eventFilters.empty());
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Config cfg;
+    if (!parseArgs(argc, argv, cfg)) {
+        std::fprintf(stderr,
+                     "usage: %s --remote HOST [--remote-port 1883] [--local HOST] [--local-port 1883]\n"
+                     "          [--state FILTER]... [--event FILTER]... [--prefix P] [--spool FILE]\n"
+                     "          [--spool-max-mb 64] [--keepalive 60] [--client-id ID] [--user U] [--pass P]\n"
+                     "          [--local-user U] [--local-pass P]\n",
+                     argv[0]);
+        return 2;
+    }
+    Bridge(cfg).run();
+    return 1;
+}
@@ -0,0 +1,569 @@
+// Deterministic fleet simulator
+// - Single-threaded, virtual millisecond clock; every random choice comes from one seeded generator
+// - Device model mirrors esp8266/src/main.cpp: dirty flag, on-demand Wi-Fi, 10-minute window,
+//   in-window reconnects, LWT on unclean drops, clean DISCONNECT when the window expires
+// - Broker model: retained door/online per device, keep-alive expiry, periodic persistence of
+//   retained state; a crash reverts to the last persisted snapshot
+// - Faults: AP reboots per site, broker crashes
+// - Links: per-site latency, jitter, bandwidth and loss (TCP retransmits); a seeded fraction of
+//   sites gets a flaky profile. Keep-alive pings cross the same link, so slow links show up as
+//   keep-alive expiry and LWT
+// - Reports how long the broker's retained state disagrees with reality and how many door
+//   transitions never reached it
+//
+// Usage: fleet_sim [--devices N] [--days D] [--seed S] [--ap-reboots-per-day R]
+//                  [--broker-crashes-per-day C] [--devices-per-site K]
+//                  [--latency-ms L] [--jitter-ms J] [--bandwidth-kbps B] [--loss P]
+//                  [--flaky-fraction F] [--flaky-latency-ms L] [--flaky-jitter-ms J]
+//                  [--flaky-bandwidth-kbps B] [--flaky-loss P]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Firmware constants (esp8266/src/main.cpp, PubSubClient defaults)
+const uint64_t DEBOUNCE_MS = 80;
+const uint64_t WINDOW_MS = 10 * 60 * 1000;
+const uint64_t RECONNECT_INTERVAL_MS = 2000;
+const uint64_t WIFI_TIMEOUT_MS = 8000;
+const uint64_t LOOP_MS = 10;
+const uint64_t KEEPALIVE_MS = 15000;
+
+// Approximate on-air sizes including TCP/IP headers
+const uint32_t SEGMENT_BYTES = 40;
+const uint32_t CONNECT_BYTES = 100;
+const uint32_t CONNACK_BYTES = 44;
+const uint32_t PUBLISH_BYTES = 60;
+const uint32_t PING_BYTES = 42;
+
+const uint64_t SECOND = 1000;
+const uint64_t MINUTE = 60 * SECOND;
+const uint64_t HOUR = 60 * MINUTE;
+const uint64_t DAY = 24 * HOUR;
+
+struct Link {
+    double latencyMs;
+    double jitterMs;       // uniform extra delay per message
+    double bandwidthKbps;
+    double loss;           // per-message loss probability
+};
+
+struct Config {
+    uint32_t devices = 1000;
+    uint32_t devicesPerSite = 4;
+    double days = 30;
+    uint64_t seed = 1;
+    Link good = {20, 5, 1000, 0.01};
+    Link flaky = {60, 250, 64, 0.08};  // congested 2.4 GHz through a garage wall
+    double flakyFraction = 0.1;        // share of sites on the flaky profile
+    double doorCyclesPerDay = 4;      // open, then close again shortly after
+    double apRebootsPerDay = 0.2;     // per site
+    double brokerCrashesPerDay = 0.05;
+    uint64_t persistIntervalMs = 30 * MINUTE;
+};
+
+struct Episodes {
+    std::vector<uint64_t> durations;
+    uint32_t openAtEnd = 0;
+
+    void print(const char* label) const {
+        std::vector<uint64_t> d = durations;
+        std::sort(d.begin(), d.end());
+        double sum = 0;
+        for (uint64_t v : d) sum += double(v);
+        auto pct = [&](double p) { return d.empty() ? 0.0 : d[size_t(p * double(d.size() - 1))] / 1000.0; };
+        std::printf("%-26s %8zu episodes  mean %8.1f s  p50 %8.1f s  p99 %9.1f s  max %9.1f s  unresolved %u\n",
+                    label, d.size(), d.empty() ? 0.0 : sum / double(d.size()) / 1000.0,
+                    pct(0.5), pct(0.99), pct(1.0), openAtEnd);
+    }
+};
+
+struct Device {
+    uint32_t site = 0;
+    Link link{};
+    bool doorOpen = false;       // physical state
+    bool stableOpen = false;     // debounced state (lastStable)
+    bool dirty = false;
+    int lastPublished = -1;
+    bool wifiUp = false;         // associated with the AP
+    bool radioOn = false;
+    bool busy = false;           // ensureMqttAndPublishIfDirty() in progress
+    bool reconnectPending = false;
+    uint64_t conn = 0;           // device's view of its MQTT connection, 0 = none
+    uint64_t windowDeadline = 0;
+    uint64_t radioOnSince = 0;
+
+    // Broker-side view of this device
+    uint64_t brokerConn = 0;
+    int retainedOpen = -1;       // -1 = no retained message
+    bool retainedOnline = false;
+    int persistedOpen = -1;
+    bool persistedOnline = false;
+
+    // Accounting
+    bool seenByBroker = true;    // current doorOpen has been retained at least once
+    uint64_t staleSince = 0;     // retained status disagrees with doorOpen since (0 = agrees)
+    uint64_t offlineSince = 0;   // broker says offline since (0 = online)
+};
+
+class Simulation {
+public:
+    explicit Simulation(const Config& cfg) : cfg_(cfg), rng_(cfg.seed), devices_(cfg.devices) {
+        sites_ = (cfg.devices + cfg.devicesPerSite - 1) / cfg.devicesPerSite;
+        apUp_.assign(sites_, true);
+        std::vector<bool> flaky(sites_);
+        for (uint32_t s = 0; s < sites_; ++s) {
+            flaky[s] = chance(cfg.flakyFraction);
+            flakySites_ += flaky[s];
+        }
+        for (uint32_t d = 0; d < cfg.devices; ++d) {
+            devices_[d].site = d / cfg.devicesPerSite;
+            devices_[d].link = flaky[devices_[d].site] ? cfg.flaky : cfg.good;
+        }
+    }
+
+    void run() {
+        uint64_t end = uint64_t(cfg_.days * double(DAY));
+        auto wallStart = std::chrono::steady_clock::now();
+
+        for (uint32_t d = 0; d < devices_.size(); ++d) {
+            Device& dev = devices_[d];
+            dev.staleSince = 1;    // no retained status until the boot publish lands
+            dev.offlineSince = 1;
+            at(uniform(0, MINUTE), [this, d] { boot(d); });
+            at(exponential(DAY / cfg_.doorCyclesPerDay), [this, d] { doorCycle(d); });
+        }
+        for (uint32_t s = 0; s < sites_; ++s) {
+            if (cfg_.apRebootsPerDay > 0) at(exponential(DAY / cfg_.apRebootsPerDay), [this, s] { apDown(s); });
+        }
+        if (cfg_.brokerCrashesPerDay > 0) at(exponential(DAY / cfg_.brokerCrashesPerDay), [this] { brokerCrash(); });
+        at(cfg_.persistIntervalMs, [this] { persist(); });
+
+        while (!queue_.empty() && queue_.top().time <= end) {
+            Event ev = queue_.top();
+            queue_.pop();
+            now_ = ev.time;
+            ev.fn();
+            ++processed_;
+        }
+        now_ = end;
+        finish();
+
+        double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+        report(wall);
+    }
+
+private:
+    struct Event {
+        uint64_t time;
+        uint64_t seq;  // FIFO among equal times keeps runs reproducible
+        std::function<void()> fn;
+    };
+    struct Later {
+        bool operator()(const Event& a, const Event& b) const {
+            return a.time != b.time ? a.time > b.time : a.seq > b.seq;
+        }
+    };
+
+    void at(uint64_t t, std::function<void()> fn) { queue_.push(Event{t, seq_++, std::move(fn)}); }
+    void after(uint64_t delay, std::function<void()> fn) { at(now_ + delay, std::move(fn)); }
+
+    uint64_t uniform(uint64_t lo, uint64_t hi) { return std::uniform_int_distribution<uint64_t>(lo, hi)(rng_); }
+    uint64_t exponential(double mean) {
+        return uint64_t(std::exponential_distribution<double>(1.0 / mean)(rng_)) + 1;
+    }
+    bool chance(double p) { return std::uniform_real_distribution<double>(0, 1)(rng_) < p; }
+
+    // One-way delivery time over the device's link: latency, jitter, serialisation at the link
+    // bandwidth, plus exponential-backoff retransmits per loss
+    uint64_t transfer(uint32_t d, uint32_t bytes) {
+        const Link& link = devices_[d].link;
+        double ms = link.latencyMs + std::uniform_real_distribution<double>(0, link.jitterMs)(rng_) +
+                    bytes * 8.0 / link.bandwidthKbps;
+        uint64_t t = uint64_t(ms);
+        uint64_t rto = 200;
+        while (chance(link.loss)) {
+            t += rto;
+            rto = std::min<uint64_t>(rto * 2, 60 * SECOND);
+        }
+        return t;
+    }
+
+    // ---------- Accounting ----------
+    void track(uint32_t d) {
+        Device& dev = devices_[d];
+        bool stale = dev.retainedOpen != int(dev.doorOpen);
+        if (!stale) dev.seenByBroker = true;
+        if (stale && !dev.staleSince) dev.staleSince = now_;
+        if (!stale && dev.staleSince) {
+            stale_.durations.push_back(now_ - dev.staleSince);
+            dev.staleSince = 0;
+        }
+        bool offline = !dev.retainedOnline;
+        if (offline && !dev.offlineSince) dev.offlineSince = now_;
+        if (!offline && dev.offlineSince) {
+            offline_.durations.push_back(now_ - dev.offlineSince);
+            dev.offlineSince = 0;
+        }
+    }
+
+    void setRetained(uint32_t d, int open, bool online) {
+        devices_[d].retainedOpen = open;
+        devices_[d].retainedOnline = online;
+        track(d);
+    }
+
+    void radio(uint32_t d, bool on) {
+        Device& dev = devices_[d];
+        if (on && !dev.radioOn) dev.radioOnSince = now_;
+        if (!on && dev.radioOn) radioOnMs_ += now_ - dev.radioOnSince;
+        dev.radioOn = on;
+    }
+
+    // ---------- Door ----------
+    void doorCycle(uint32_t d) {
+        setDoor(d, true);
+        after(uniform(20 * SECOND, 2 * MINUTE), [this, d] { setDoor(d, false); });
+        after(exponential(DAY / cfg_.doorCyclesPerDay), [this, d] { doorCycle(d); });
+    }
+
+    void setDoor(uint32_t d, bool open) {
+        Device& dev = devices_[d];
+        if (dev.doorOpen == open) return;
+        ++transitions_;
+        if (!dev.seenByBroker) ++lost_;
+        dev.doorOpen = open;
+        dev.seenByBroker = false;
+        track(d);
+        after(DEBOUNCE_MS, [this, d, open] {
+            Device& dv = devices_[d];
+            if (dv.doorOpen != open || dv.stableOpen == open) return;
+            dv.stableOpen = open;
+            dv.dirty = true;
+            kick(d);
+        });
+    }
+
+    // ---------- Device: ensureMqttAndPublishIfDirty() ----------
+    void boot(uint32_t d) {
+        devices_[d].dirty = true;  // PUBLISH_ON_BOOT
+        kick(d);
+    }
+
+    void kick(uint32_t d) {
+        Device& dev = devices_[d];
+        if (!dev.dirty || dev.busy) return;
+        if (dev.lastPublished == int(dev.stableOpen)) {
+            dev.dirty = false;  // back to what the broker already has
+            return;
+        }
+        dev.busy = true;
+        if (dev.wifiUp) {
+            mqttStep(d);
+            return;
+        }
+        radio(d, true);
+        if (!apUp_[dev.site]) {
+            after(WIFI_TIMEOUT_MS, [this, d] { fail(d); });
+            return;
+        }
+        after(uniform(1500, 4000), [this, d] {
+            if (!apUp_[devices_[d].site]) {
+                after(WIFI_TIMEOUT_MS, [this, d] { fail(d); });
+                return;
+            }
+            devices_[d].wifiUp = true;
+            mqttStep(d);
+        });
+    }
+
+    // The radio stays on while loop() keeps retrying
+    void fail(uint32_t d) {
+        devices_[d].busy = false;
+        after(LOOP_MS, [this, d] { kick(d); });
+    }
+
+    void mqttStep(uint32_t d) {
+        Device& dev = devices_[d];
+        if (dev.conn) {
+            publishStep(d);
+            return;
+        }
+        connect(d, [this, d](bool ok) {
+            if (ok) {
+                publishStep(d);
+            } else {
+                fail(d);
+            }
+        });
+    }
+
+    // TCP handshake plus CONNECT/CONNACK; also publishes online "true" like mqttConnect()
+    void connect(uint32_t d, std::function<void(bool)> done) {
+        uint64_t there = transfer(d, SEGMENT_BYTES);  // SYN
+        uint64_t rtt = there + transfer(d, SEGMENT_BYTES) + transfer(d, CONNECT_BYTES) + transfer(d, CONNACK_BYTES);
+        after(there, [this, d, rtt, there, done] {
+            Device& dev = devices_[d];
+            bool ok = brokerUp_ && apUp_[dev.site] && dev.wifiUp;
+            uint64_t c = ok ? ++connSeq_ : 0;
+            if (ok) {
+                // Takeover of a half-open session: no LWT
+                dev.brokerConn = c;
+                setRetained(d, dev.retainedOpen, true);
+            }
+            after(ok ? rtt - there : there, [this, d, c, done] {
+                Device& dv = devices_[d];
+                bool alive = c && dv.brokerConn == c && dv.wifiUp;
+                if (alive) {
+                    dv.conn = c;
+                    after(KEEPALIVE_MS, [this, d, c] { ping(d, c); });
+                } else if (c) {
+                    // Link went away during the handshake; the broker holds a half-open session
+                    after(KEEPALIVE_MS * 3 / 2, [this, d, c] { keepAliveExpired(d, c); });
+                }
+                done(alive);
+            });
+        });
+    }
+
+    void publishStep(uint32_t d) {
+        Device& dev = devices_[d];
+        bool value = dev.stableOpen;
+        uint64_t c = dev.conn;
+        // PubSubClient reports success once the packet is written; delivery can still be lost
+        after(transfer(d, PUBLISH_BYTES), [this, d, c, value] {
+            Device& dv = devices_[d];
+            if (brokerUp_ && dv.brokerConn == c) setRetained(d, value, dv.retainedOnline);
+        });
+        dev.dirty = false;
+        dev.lastPublished = value;
+        dev.windowDeadline = now_ + WINDOW_MS;
+        dev.busy = false;
+        uint64_t deadline = dev.windowDeadline;
+        after(WINDOW_MS, [this, d, deadline] { windowCheck(d, deadline); });
+    }
+
+    void windowCheck(uint32_t d, uint64_t deadline) {
+        Device& dev = devices_[d];
+        if (dev.windowDeadline != deadline || dev.dirty || !dev.conn) return;
+        // wifiRadioSleep(): clean DISCONNECT, so no LWT; online stays "true"
+        dev.conn = 0;
+        dev.brokerConn = 0;
+        dev.wifiUp = false;
+        radio(d, false);
+    }
+
+    // PubSubClient pings after KEEPALIVE_MS idle and gives up if PINGRESP takes another KEEPALIVE_MS;
+    // the broker expires the session after 1.5x KEEPALIVE_MS without traffic
+    void ping(uint32_t d, uint64_t c) {
+        Device& dev = devices_[d];
+        if (dev.conn != c) return;
+        uint64_t up = transfer(d, PING_BYTES);
+        uint64_t down = transfer(d, PING_BYTES);
+        if (up > KEEPALIVE_MS / 2) {
+            after(KEEPALIVE_MS / 2, [this, d, c] {
+                if (devices_[d].brokerConn == c) ++keepAliveExpiries_;
+                keepAliveExpired(d, c);
+            });
+        }
+        if (up + down > KEEPALIVE_MS) {
+            after(KEEPALIVE_MS, [this, d, c] {
+                Device& dv = devices_[d];
+                if (dv.conn != c) return;
+                dv.conn = 0;
+                scheduleReconnect(d);
+            });
+            return;
+        }
+        after(KEEPALIVE_MS, [this, d, c] { ping(d, c); });
+    }
+
+    // Loop branch: MQTT dropped while Wi-Fi is up and the window is open
+    void scheduleReconnect(uint32_t d) {
+        Device& dev = devices_[d];
+        if (dev.reconnectPending) return;
+        dev.reconnectPending = true;
+        after(RECONNECT_INTERVAL_MS, [this, d] {
+            Device& dv = devices_[d];
+            dv.reconnectPending = false;
+            if (dv.conn || dv.busy || !dv.wifiUp || now_ > dv.windowDeadline) return;
+            if (dv.dirty) {
+                kick(d);
+                return;
+            }
+            dv.busy = true;
+            connect(d, [this, d](bool ok) {
+                devices_[d].busy = false;
+                if (!ok) scheduleReconnect(d);
+            });
+        });
+    }
+
+    // ---------- Faults ----------
+    void apDown(uint32_t s) {
+        apUp_[s] = false;
+        ++apReboots_;
+        for (uint32_t d = s * cfg_.devicesPerSite; d < std::min<uint32_t>((s + 1) * cfg_.devicesPerSite, cfg_.devices); ++d) {
+            Device& dev = devices_[d];
+            if (!dev.wifiUp) continue;
+            // Radio stays on: the firmware only sleeps it from the connected branch of loop()
+            dev.wifiUp = false;
+            if (dev.conn) {
+                // The device sees the link drop; the broker only notices at keep-alive expiry
+                uint64_t c = dev.conn;
+                dev.conn = 0;
+                after(KEEPALIVE_MS * 3 / 2 - uniform(0, KEEPALIVE_MS), [this, d, c] { keepAliveExpired(d, c); });
+            }
+        }
+        after(uniform(1 * MINUTE, 3 * MINUTE), [this, s] {
+            apUp_[s] = true;
+            after(exponential(DAY / cfg_.apRebootsPerDay), [this, s] { apDown(s); });
+        });
+    }
+
+    void keepAliveExpired(uint32_t d, uint64_t c) {
+        Device& dev = devices_[d];
+        if (!brokerUp_ || dev.brokerConn != c) return;
+        dev.brokerConn = 0;
+        setRetained(d, dev.retainedOpen, false);  // LWT
+        // The broker closes the socket; a device that still holds the connection sees the FIN
+        // and loop() reconnects within RECONNECT_INTERVAL_MS
+        if (dev.conn == c && dev.wifiUp) {
+            after(transfer(d, SEGMENT_BYTES), [this, d, c] {
+                Device& dv = devices_[d];
+                if (dv.conn != c) return;
+                dv.conn = 0;
+                scheduleReconnect(d);
+            });
+        }
+    }
+
+    void persist() {
+        if (brokerUp_) {
+            for (Device& dev : devices_) {
+                dev.persistedOpen = dev.retainedOpen;
+                dev.persistedOnline = dev.retainedOnline;
+            }
+        }
+        after(cfg_.persistIntervalMs, [this] { persist(); });
+    }
+
+    void brokerCrash() {
+        brokerUp_ = false;
+        ++brokerCrashes_;
+        for (uint32_t d = 0; d < devices_.size(); ++d) {
+            Device& dev = devices_[d];
+            dev.brokerConn = 0;
+            if (dev.conn) {
+                dev.conn = 0;  // RST from the broker host
+                scheduleReconnect(d);
+            }
+        }
+        after(uniform(10 * SECOND, 2 * MINUTE), [this] {
+            brokerUp_ = true;
+            for (uint32_t d = 0; d < devices_.size(); ++d) {
+                setRetained(d, devices_[d].persistedOpen, devices_[d].persistedOnline);
+            }
+            after(exponential(DAY / cfg_.brokerCrashesPerDay), [this] { brokerCrash(); });
+        });
+    }
+
+    // ---------- Report ----------
+    void finish() {
+        for (Device& dev : devices_) {
+            if (dev.staleSince) ++stale_.openAtEnd;
+            if (dev.offlineSince) ++offline_.openAtEnd;
+            if (dev.radioOn) radioOnMs_ += now_ - dev.radioOnSince;
+        }
+    }
+
+    void report(double wallSeconds) const {
+        std::printf("simulated %.1f days, %u devices in %u sites (%u flaky), seed %llu\n", cfg_.days,
+                    cfg_.devices, sites_, flakySites_, static_cast<unsigned long long>(cfg_.seed));
+        std::printf("faults: %u AP reboots, %u broker crashes, %llu keep-alive expiries\n", apReboots_,
+                    brokerCrashes_, static_cast<unsigned long long>(keepAliveExpiries_));
+        std::printf("door transitions: %llu, never reached broker: %llu\n",
+                    static_cast<unsigned long long>(transitions_), static_cast<unsigned long long>(lost_));
+        stale_.print("stale retained status:");
+        offline_.print("retained online=false:");
+        std::printf("radio on: %.2f h per device per day\n",
+                    double(radioOnMs_) / double(HOUR) / double(cfg_.devices) / cfg_.days);
+        std::printf("%llu events in %.2f s wall\n", static_cast<unsigned long long>(processed_), wallSeconds);
+    }
+
+    Config cfg_;
+    std::mt19937_64 rng_;
+    std::priority_queue<Event, std::vector<Event>, Later> queue_;
+    uint64_t now_ = 0;
+    uint64_t seq_ = 0;
+    uint64_t processed_ = 0;
+
+    std::vector<Device> devices_;
+    uint32_t sites_ = 0;
+    uint32_t flakySites_ = 0;
+    std::vector<bool> apUp_;
+    bool brokerUp_ = true;
+    uint64_t connSeq_ = 0;
+
+    uint32_t apReboots_ = 0;
+    uint32_t brokerCrashes_ = 0;
+    uint64_t transitions_ = 0;
+    uint64_t lost_ = 0;
+    uint64_t keepAliveExpiries_ = 0;
+    uint64_t radioOnMs_ = 0;
+    Episodes stale_;
+    Episodes offline_;
+};
+
+bool parseArgs(int argc, char** argv, Config& cfg) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char* k = argv[i];
+        const char* v = argv[i + 1];
+        if (!std::strcmp(k, "--devices")) cfg.devices = uint32_t(std::strtoul(v, nullptr, 10));
+        else if (!std::strcmp(k, "--devices-per-site")) cfg.devicesPerSite = uint32_t(std::strtoul(v, nullptr, 10));
+        else if (!std::strcmp(k, "--days")) cfg.days = std::strtod(v, nullptr);
+        else if (!std::strcmp(k, "--seed")) cfg.seed = std::strtoull(v, nullptr, 10);
+        else if (!std::strcmp(k, "--latency-ms")) cfg.good.latencyMs = std::strtod(v, nullptr);
+        else if (!std::strcmp(k, "--jitter-ms")) cfg.good.jitterMs = std::strtod(v, nullptr);
+        else if (!std::strcmp(k, "--bandwidth-kbps")) cfg.good.bandwidthKbps = std::strtod(v, nullptr);
+        else if (!std::strcmp(k, "--loss")) cfg.good.loss = std::strtod(v, nullptr);
+        else if (!std::strcmp(k, "--flaky-fraction")) cfg.flakyFraction = std::strtod(v, nullptr);
+        else if (!std::strcmp(k, "--flaky-latency-ms")) cfg.flaky.latencyMs = std::strtod(v, nullptr);
+        else if (!std::strcmp(k, "--flaky-jitter-ms")) cfg.flaky.jitterMs = std::strtod(v, nullptr);
+        else if (!std::strcmp(k, "--flaky-bandwidth-kbps")) cfg.flaky.bandwidthKbps = std::strtod(v, nullptr);
+        else if (!std::strcmp(k, "--flaky-loss")) cfg.flaky.loss = std::strtod(v, nullptr);
+        else if (!std::strcmp(k, "--ap-reboots-per-day")) cfg.apRebootsPerDay = std::strtod(v, nullptr);
+        else if (!std::strcmp(k, "--broker-crashes-per-day")) cfg.brokerCrashesPerDay = std::strtod(v, nullptr);
+        else return false;
+    }
+    return argc % 2 == 1 && cfg.devices > 0 && cfg.devicesPerSite > 0 && cfg.good.loss < 1 && cfg.flaky.loss < 1 &&
+           cfg.good.bandwidthKbps > 0 && cfg.flaky.bandwidthKbps > 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Config cfg;
+    if (!parseArgs(argc, argv, cfg)) {
+        std::fprintf(stderr,
+                     "usage: %s [--devices N] [--days D] [--seed S] [--ap-reboots-per-day R]\n"
+                     "          [--broker-crashes-per-day C] [--devices-per-site K]\n"
+                     "          [--latency-ms L] [--jitter-ms J] [--bandwidth-kbps B] [--loss P]\n"
+                     "          [--flaky-fraction F] [--flaky-latency-ms L] [--flaky-jitter-ms J]\n"
+                     "          [--flaky-bandwidth-kbps B] [--flaky-loss P]\n",
+                     argv[0]);
+        return 2;
+    }
+    Simulation(cfg).run();
+    return 0;
+}
@@ -0,0 +1,189 @@
+#include "fleet_state_index.h"
+
+namespace garage {
+
+namespace {
+
+const std::string_view DOOR_SUFFIX = "/door";
+const std::string_view ONLINE_SUFFIX = "/door/online";
+
+bool endsWith(std::string_view s, std::string_view suffix) {
+    return s.size() > suffix.size() && s.substr(s.size() - suffix.size()) == suffix;
+}
+
+template <typename Combine>
+size_t popcountLoop(size_t words, Combine combine) {
+    size_t total = 0;
+    for (size_t i = 0; i < words; ++i) {
+        total += static_cast<size_t>(__builtin_popcountll(combine(i)));
+    }
+    return total;
+}
+
+// Word-wise popcount over a combination of bitsets. A baseline x86-64 build lowers
+// __builtin_popcountll to a libgcc call per word, so unless the build already targets POPCNT
+// a second copy compiled for it is chosen once at startup by a CPU check.
+#if defined(__x86_64__) && !defined(__POPCNT__)
+bool cpuHasPopcnt() {
+    __builtin_cpu_init();  // may run before the constructor that normally does this
+    return __builtin_cpu_supports("popcnt");
+}
+
+const bool HAVE_POPCNT = cpuHasPopcnt();
+
+template <typename Combine>
+__attribute__((target("popcnt"))) size_t popcountLoopHw(size_t words, Combine combine) {
+    return popcountLoop(words, combine);
+}
+
+template <typename Combine>
+size_t popcountWords(size_t words, Combine combine) {
+    return HAVE_POPCNT ? popcountLoopHw(words, combine) : popcountLoop(words, combine);
+}
+#else
+template <typename Combine>
+size_t popcountWords(size_t words, Combine combine) {
+    return popcountLoop(words, combine);
+}
+#endif
+
+} // namespace
+
+bool FleetStateIndex::apply(std::string_view topic, std::string_view payload) {
+    bool isOnline = endsWith(topic, ONLINE_SUFFIX);
+    if (!isOnline && !endsWith(topic, DOOR_SUFFIX)) return false;
+
+    std::string_view device = topic.substr(0, topic.size() - (isOnline ? ONLINE_SUFFIX : DOOR_SUFFIX).size());
+
+    bool on;
+    if (payload.empty()) {
+        on = false;
+    } else if (isOnline && (payload == "true" || payload == "false")) {
+        on = payload == "true";
+    } else if (!isOnline && (payload == "open" || payload == "closed")) {
+        on = payload == "open";
+    } else {
+        return false; // unknown payload: leave state untouched
+    }
+
+    uint32_t dev;
+    if (payload.empty()) {
+        // A cleared retained message for a device we never saw carries no state
+        dev = devices_.find(device);
+        if (dev == InternTable::NOT_FOUND) return false;
+    } else {
+        dev = internDevice(device);
+    }
+    Bits& bits = isOnline ? online_ : open_;
+    uint64_t mask = uint64_t(1) << (dev % 64);
+    bool was = (bits[dev / 64] & mask) != 0;
+    setBit(bits, dev, on);
+    if (was != on) ++generation_;
+    return was != on;
+}
+
+uint32_t FleetStateIndex::internDevice(std::string_view device) {
+    size_t before = devices_.size();
+    uint32_t dev = devices_.intern(device);
+    if (devices_.size() == before) return dev;
+
+    ++generation_;
+
+    size_t words = dev / 64 + 1;
+    if (known_.size() < words) {
+        known_.resize(words, 0);
+        open_.resize(words, 0);
+        online_.resize(words, 0);
+        for (Bits& s : siteBits_) s.resize(words, 0);
+    }
+    setBit(known_, dev, true);
+    siteOf_.push_back(InternTable::NOT_FOUND);
+
+    size_t slash = device.find('/');
+    if (slash != std::string_view::npos) joinSite(dev, device.substr(0, slash));
+    return dev;
+}
+
+void FleetStateIndex::setSite(std::string_view device, std::string_view site) {
+    uint32_t dev = internDevice(device);
+    if (siteOf_[dev] != InternTable::NOT_FOUND) {
+        if (sites_.name(siteOf_[dev]) == site) return;
+        setBit(siteBits_[siteOf_[dev]], dev, false);
+    }
+    joinSite(dev, site);
+    ++generation_;
+}
+
+void FleetStateIndex::joinSite(uint32_t dev, std::string_view site) {
+    uint32_t id = sites_.intern(site);
+    if (id == siteBits_.size()) siteBits_.emplace_back(known_.size(), 0);
+    setBit(siteBits_[id], dev, true);
+    siteOf_[dev] = id;
+}
+
+void FleetStateIndex::setBit(Bits& b, uint32_t dev, bool on) {
+    uint64_t mask = uint64_t(1) << (dev % 64);
+    if (on) {
+        b[dev / 64] |= mask;
+    } else {
+        b[dev / 64] &= ~mask;
+    }
+}
+
+uint64_t FleetStateIndex::word(Query q, size_t i) const {
+    switch (q) {
+        case Query::Open:        return open_[i];
+        case Query::Online:      return online_[i];
+        case Query::Offline:     return known_[i] & ~online_[i];
+        case Query::OnlineOpen:  return online_[i] & open_[i];
+        case Query::OfflineOpen: return known_[i] & ~online_[i] & open_[i];
+    }
+    return 0;
+}
+
+size_t FleetStateIndex::count(Query q) const {
+    const uint64_t* k = known_.data();
+    const uint64_t* o = open_.data();
+    const uint64_t* n = online_.data();
+    size_t words = known_.size();
+    // One loop per query keeps each body free of the switch.
+    switch (q) {
+        case Query::Open:        return popcountWords(words, [&](size_t i) { return o[i]; });
+        case Query::Online:      return popcountWords(words, [&](size_t i) { return n[i]; });
+        case Query::Offline:     return popcountWords(words, [&](size_t i) { return k[i] & ~n[i]; });
+        case Query::OnlineOpen:  return popcountWords(words, [&](size_t i) { return n[i] & o[i]; });
+        case Query::OfflineOpen: return popcountWords(words, [&](size_t i) { return k[i] & ~n[i] & o[i]; });
+    }
+    return 0;
+}
+
+size_t FleetStateIndex::countSite(std::string_view site, Query q) const {
+    uint32_t id = sites_.find(site);
+    if (id == InternTable::NOT_FOUND) return 0;
+    const uint64_t* s = siteBits_[id].data();
+    const uint64_t* o = open_.data();
+    const uint64_t* n = online_.data();
+    size_t words = known_.size();
+    switch (q) {
+        case Query::Open:        return popcountWords(words, [&](size_t i) { return s[i] & o[i]; });
+        case Query::Online:      return popcountWords(words, [&](size_t i) { return s[i] & n[i]; });
+        case Query::Offline:     return popcountWords(words, [&](size_t i) { return s[i] & ~n[i]; });
+        case Query::OnlineOpen:  return popcountWords(words, [&](size_t i) { return s[i] & n[i] & o[i]; });
+        case Query::OfflineOpen: return popcountWords(words, [&](size_t i) { return s[i] & ~n[i] & o[i]; });
+    }
+    return 0;
+}
+
+std::vector<uint32_t> FleetStateIndex::devices(Query q) const {
+    std::vector<uint32_t> out;
+    for (size_t i = 0; i < known_.size(); ++i) {
+        uint64_t w = word(q, i);
+        while (w) {
+            out.push_back(static_cast<uint32_t>(i * 64 + __builtin_ctzll(w)));
+            w &= w - 1;
+        }
+    }
+    return out;
+}
+
+} // namespace garage
@@ -0,0 +1,79 @@
+// Fleet-wide door state index
+// - One bit per device in dense "open" and "online" bitsets
+// - Fed from retained <device>/door ("open"/"closed") and <device>/door/online ("true"/"false")
+// - Device numbers are assigned on first sight and never reused, so bit positions stay stable
+// - Per-site queries intersect with a site membership bitset. Sites come from the topic layout
+//   <site>/<device>/door: the first level of a multi-level device name is its site. A single-level
+//   device (<device>/door, as with a +/door subscription) belongs to no site unless setSite() gives one
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "intern_table.h"
+
+namespace garage {
+
+class FleetStateIndex {
+public:
+    enum class Query {
+        Open,          // door last reported open
+        Online,        // online topic is "true"
+        Offline,       // known device whose online topic is not "true"
+        OnlineOpen,    // online and open
+        OfflineOpen,   // offline but last seen open
+    };
+
+    // Apply one retained message. Topics other than .../door and .../door/online are ignored.
+    // An empty payload (retained message cleared) resets the corresponding bit; it is ignored for
+    // devices not seen before.
+    // Returns true if the message was recognised and changed a bit.
+    bool apply(std::string_view topic, std::string_view payload);
+
+    // Assign a device to a site explicitly, e.g. from an inventory list. Interns the device if new;
+    // a device belongs to at most one site, so this replaces a site taken from its topic.
+    void setSite(std::string_view device, std::string_view site);
+
+    size_t count(Query q) const;
+    size_t countSite(std::string_view site, Query q) const;
+
+    // Device numbers matching a query, in ascending order.
+    std::vector<uint32_t> devices(Query q) const;
+
+    size_t deviceCount() const { return devices_.size(); }
+    const std::string& deviceName(uint32_t dev) const { return devices_.name(dev); }
+    bool isOpen(uint32_t dev) const { return (open_[dev / 64] >> (dev % 64)) & 1; }
+    bool isOnline(uint32_t dev) const { return (online_[dev / 64] >> (dev % 64)) & 1; }
+
+    // Raw bitsets, 64 devices per word, bit (dev % 64) of word (dev / 64).
+    const std::vector<uint64_t>& openBits() const { return open_; }
+    const std::vector<uint64_t>& onlineBits() const { return online_; }
+
+    // Bumped whenever a bit changes or a device is added; cheap change detection for caches.
+    uint64_t generation() const { return generation_; }
+
+private:
+    using Bits = std::vector<uint64_t>;
+
+    uint32_t internDevice(std::string_view device);
+    void joinSite(uint32_t dev, std::string_view site);
+    uint64_t word(Query q, size_t i) const;
+
+    static void setBit(Bits& b, uint32_t dev, bool on);
+
+    InternTable devices_;
+    InternTable sites_;
+
+    Bits known_;               // every assigned device number
+    Bits open_;
+    Bits online_;
+    std::vector<Bits> siteBits_;  // membership per site id
+    std::vector<uint32_t> siteOf_;  // per device, InternTable::NOT_FOUND when it has no site
+    uint64_t generation_ = 0;
+};
+
+} // namespace garage
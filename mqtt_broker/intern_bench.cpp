@@ -0,0 +1,97 @@
+// InternTable lookup benchmark against std::unordered_map
+// - N distinct "esp-<hex>" client IDs (the firmware's makeClientId() shape), looked up in random order
+// - Reports ns per lookup for: hashing inline, pre-hashed keys, std::unordered_map<std::string, uint32_t>
+//
+// Usage: intern_bench [--ids N] [--lookups M] [--seed S]
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "intern_table.h"
+
+namespace {
+
+struct Config {
+    size_t ids = 1000000;
+    size_t lookups = 10000000;
+    uint64_t seed = 1;
+};
+
+template <typename F>
+double nsPerOp(size_t ops, F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / double(ops);
+}
+
+bool parseArgs(int argc, char** argv, Config& cfg) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char* k = argv[i];
+        const char* v = argv[i + 1];
+        if (!std::strcmp(k, "--ids")) cfg.ids = std::strtoull(v, nullptr, 10);
+        else if (!std::strcmp(k, "--lookups")) cfg.lookups = std::strtoull(v, nullptr, 10);
+        else if (!std::strcmp(k, "--seed")) cfg.seed = std::strtoull(v, nullptr, 10);
+        else return false;
+    }
+    return argc % 2 == 1 && cfg.ids > 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Config cfg;
+    if (!parseArgs(argc, argv, cfg)) {
+        std::fprintf(stderr, "usage: %s [--ids N] [--lookups M] [--seed S]\n", argv[0]);
+        return 2;
+    }
+
+    std::mt19937_64 rng(cfg.seed);
+    std::vector<std::string> keys;
+    keys.reserve(cfg.ids);
+    for (size_t i = 0; i < cfg.ids; ++i) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "esp-%llx", static_cast<unsigned long long>(rng() & 0xFFFFFFFFFFULL));
+        keys.push_back(buf);
+    }
+    std::vector<uint32_t> order(cfg.lookups);
+    for (uint32_t& o : order) o = uint32_t(rng() % cfg.ids);
+
+    garage::InternTable table;
+    std::unordered_map<std::string, uint32_t> map;
+    double internNs = nsPerOp(keys.size(), [&] {
+        for (const std::string& k : keys) table.intern(k);
+    });
+    double mapInsertNs = nsPerOp(keys.size(), [&] {
+        for (const std::string& k : keys) map.emplace(k, uint32_t(map.size()));
+    });
+
+    std::vector<uint64_t> hashes(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) hashes[i] = garage::InternTable::hash(keys[i]);
+
+    // Sum the results so the lookups cannot be optimised away
+    uint64_t sink = 0;
+    double findNs = nsPerOp(order.size(), [&] {
+        for (uint32_t o : order) sink += table.find(keys[o]);
+    });
+    double prehashedNs = nsPerOp(order.size(), [&] {
+        for (uint32_t o : order) sink += table.find(keys[o], hashes[o]);
+    });
+    double mapFindNs = nsPerOp(order.size(), [&] {
+        for (uint32_t o : order) sink += map.find(keys[o])->second;
+    });
+
+    std::printf("%zu ids (%zu distinct), %zu random lookups\n", keys.size(), table.size(), order.size());
+    std::printf("  insert     InternTable %7.1f ns   unordered_map %7.1f ns\n", internNs, mapInsertNs);
+    std::printf("  lookup     InternTable %7.1f ns   unordered_map %7.1f ns\n", findNs, mapFindNs);
+    std::printf("  prehashed  InternTable %7.1f ns\n", prehashedNs);
+    std::printf("  (checksum %llu)\n", static_cast<unsigned long long>(sink));
+    return 0;
+}
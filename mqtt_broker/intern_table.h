@@ -0,0 +1,129 @@
+// Open-addressing intern table for client and device IDs
+// - Maps each distinct string to a dense id (0, 1, 2, ...) that is never reused
+// - Swiss-table layout: one control byte per slot (7 hash bits or EMPTY), probed 16 at a time
+// - Callers that already hold the hash (e.g. computed once per packet) can pass it in
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace garage {
+
+class InternTable {
+public:
+    static constexpr uint32_t NOT_FOUND = UINT32_MAX;
+
+    InternTable() { rehash(1); }
+
+    static uint64_t hash(std::string_view s) {
+        // murmur3 finaliser on top of std::hash so both the group index and the 7-bit tag are well mixed
+        uint64_t h = std::hash<std::string_view>()(s);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    uint32_t find(std::string_view s) const { return find(s, hash(s)); }
+
+    uint32_t find(std::string_view s, uint64_t h) const {
+        size_t mask = groups_ - 1;
+        size_t g = h >> 7;
+        for (size_t step = 1;; ++step) {
+            g &= mask;
+            const int8_t* ctrl = &ctrl_[g * GROUP];
+            for (uint32_t m = matchTag(ctrl, tagOf(h)); m; m &= m - 1) {
+                const Slot& slot = slots_[g * GROUP + __builtin_ctz(m)];
+                if (slot.hash == h && names_[slot.id] == s) return slot.id;
+            }
+            if (matchTag(ctrl, EMPTY)) return NOT_FOUND;
+            g += step;  // triangular probing visits every group when the count is a power of two
+        }
+    }
+
+    // Returns the id of s, assigning the next id if it has not been seen before.
+    uint32_t intern(std::string_view s) { return intern(s, hash(s)); }
+
+    uint32_t intern(std::string_view s, uint64_t h) {
+        uint32_t id = find(s, h);
+        if (id != NOT_FOUND) return id;
+        if ((names_.size() + 1) * 8 > groups_ * GROUP * 7) rehash(groups_ * 2);  // max load 7/8
+        id = static_cast<uint32_t>(names_.size());
+        names_.emplace_back(s);
+        insert(h, id);
+        return id;
+    }
+
+    const std::string& name(uint32_t id) const { return names_[id]; }
+    size_t size() const { return names_.size(); }
+
+private:
+    static constexpr size_t GROUP = 16;
+    static constexpr int8_t EMPTY = -128;
+
+    struct Slot {
+        uint64_t hash;
+        uint32_t id;
+    };
+
+    static int8_t tagOf(uint64_t h) { return static_cast<int8_t>(h & 0x7F); }
+
+    // Bit i set when ctrl[i] == tag.
+    static uint32_t matchTag(const int8_t* ctrl, int8_t tag) {
+#if defined(__SSE2__)
+        __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(tag))));
+#else
+        uint32_t m = 0;
+        for (size_t i = 0; i < GROUP; ++i) {
+            m |= uint32_t(ctrl[i] == tag) << i;
+        }
+        return m;
+#endif
+    }
+
+    void insert(uint64_t h, uint32_t id) {
+        size_t mask = groups_ - 1;
+        size_t g = h >> 7;
+        for (size_t step = 1;; ++step) {
+            g &= mask;
+            uint32_t empty = matchTag(&ctrl_[g * GROUP], EMPTY);
+            if (empty) {
+                size_t i = g * GROUP + __builtin_ctz(empty);
+                ctrl_[i] = tagOf(h);
+                slots_[i] = Slot{h, id};
+                return;
+            }
+            g += step;
+        }
+    }
+
+    void rehash(size_t groups) {
+        std::vector<int8_t> oldCtrl(groups * GROUP, EMPTY);
+        std::vector<Slot> oldSlots(groups * GROUP);
+        oldCtrl.swap(ctrl_);
+        oldSlots.swap(slots_);
+        groups_ = groups;
+        for (size_t i = 0; i < oldCtrl.size(); ++i) {
+            if (oldCtrl[i] != EMPTY) insert(oldSlots[i].hash, oldSlots[i].id);
+        }
+    }
+
+    size_t groups_ = 0;
+    std::vector<int8_t> ctrl_;
+    std::vector<Slot> slots_;
+    std::vector<std::string> names_;  // interned strings, indexed by id
+};
+
+} // namespace garage
@@ -0,0 +1,359 @@
+// MQTT-SN to MQTT gateway for the firmware's UDP publish path (esp8266 built with -D USE_MQTTSN)
+// - Accepts QoS -1 PUBLISH datagrams with pre-defined topic IDs; the topic file maps IDs to topics
+// - Every datagram drained by one recvmmsg() is re-encoded as MQTT PUBLISH and sent upstream in
+//   one write over a single broker connection
+// - Stateless per device: no CONNECT, session or keep-alive, so a sleeping device costs nothing
+//   and is never expired. QoS -1 also means no LWT; devices send online "true" once per boot
+// - Publishes that could not be written upstream (broker unreachable, write failed, or still in
+//   the send queue when the connection dropped) are kept as the newest payload per topic ID and
+//   sent on reconnect
+// - MQTT-SN has no authentication: any host that can reach the port can publish to every
+//   pre-registered topic, bypassing the broker's credentials. Restrict senders with --allow
+//   (repeatable, address or CIDR prefix; IPv4 or IPv6) and keep the port off untrusted networks
+//
+// Topic file: one "<id> <topic>" per line, '#' starts a comment
+//
+// Usage: mqttsn_gateway --topics FILE [--port 1884] [--broker HOST] [--broker-port 1883]
+//                       [--user U] [--pass P] [--allow ADDR[/PREFIX]]...
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../esp8266/lib/mqtt_packets/mqtt_packets.h"
+#include "../esp8266/lib/mqtt_packets/mqttsn_packets.h"
+#include "subscriber.h"
+
+namespace {
+
+const unsigned BATCH = 64;
+const size_t DATAGRAM_MAX = 512;
+
+// Source address filter; IPv4 rules are stored as v4-mapped IPv6
+struct AllowRule {
+    in6_addr addr;
+    unsigned prefix;
+};
+
+struct Config {
+    std::vector<AllowRule> allow;  // empty = accept any source
+    std::string topicsFile;
+    uint16_t port = 1884;
+    std::string broker = "127.0.0.1";
+    uint16_t brokerPort = 1883;
+    std::string user;
+    std::string pass;
+};
+
+struct Pending {
+    std::string payload;
+    bool retain;
+};
+
+// Accepted datagram; data points into the receive buffers until the next recvmmsg()
+struct Item {
+    uint16_t topicId;
+    const uint8_t* data;
+    size_t len;
+    bool retain;
+};
+
+struct Stats {
+    uint64_t forwarded = 0;
+    uint64_t unknownTopic = 0;
+    uint64_t rejected = 0;  // malformed, or not QoS -1 with a pre-defined topic ID
+    uint64_t denied = 0;    // source not in --allow
+};
+
+uint64_t nowMs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000 + uint64_t(ts.tv_nsec) / 1000000;
+}
+
+bool loadTopics(const std::string& path, std::unordered_map<uint16_t, std::string>& topics) {
+    std::ifstream in(path);
+    if (!in) return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) line.resize(hash);
+        std::istringstream fields(line);
+        unsigned long id;
+        std::string topic;
+        if (!(fields >> id)) continue;
+        if (!(fields >> topic) || id == 0 || id > 0xFFFF) return false;
+        topics[uint16_t(id)] = topic;
+    }
+    return !topics.empty();
+}
+
+bool parseAllow(const char* spec, AllowRule& rule) {
+    std::string s(spec);
+    size_t slash = s.find('/');
+    std::string addr = s.substr(0, slash);
+    in_addr v4;
+    unsigned max;
+    if (inet_pton(AF_INET, addr.c_str(), &v4) == 1) {
+        rule.addr = in6_addr{};
+        rule.addr.s6_addr[10] = 0xFF;
+        rule.addr.s6_addr[11] = 0xFF;
+        std::memcpy(&rule.addr.s6_addr[12], &v4, 4);
+        max = 32;
+    } else if (inet_pton(AF_INET6, addr.c_str(), &rule.addr) == 1) {
+        max = 128;
+    } else {
+        return false;
+    }
+    unsigned prefix = slash == std::string::npos ? max : unsigned(std::strtoul(s.c_str() + slash + 1, nullptr, 10));
+    if (prefix > max) return false;
+    rule.prefix = prefix + (128 - max);
+    return true;
+}
+
+bool allowed(const std::vector<AllowRule>& rules, const in6_addr& a) {
+    if (rules.empty()) return true;
+    for (const AllowRule& r : rules) {
+        unsigned bits = r.prefix;
+        size_t i = 0;
+        for (; bits >= 8 && a.s6_addr[i] == r.addr.s6_addr[i]; ++i) bits -= 8;
+        if (bits >= 8) continue;
+        uint8_t mask = uint8_t(0xFF << (8 - bits));
+        if (bits == 0 || ((a.s6_addr[i] ^ r.addr.s6_addr[i]) & mask) == 0) return true;
+    }
+    return false;
+}
+
+int openUdp(uint16_t port) {
+    int fd = ::socket(AF_INET6, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    int zero = 0;
+    setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+    sockaddr_in6 addr{};
+    addr.sin6_family = AF_INET6;
+    addr.sin6_addr = in6addr_any;
+    addr.sin6_port = htons(port);
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+class Gateway {
+public:
+    Gateway(const Config& cfg, std::unordered_map<uint16_t, std::string> topics, int udp)
+        : cfg_(cfg), topics_(std::move(topics)), udp_(udp), upstream_("mqttsn-gateway"),
+          bufs_(BATCH * DATAGRAM_MAX) {
+        for (unsigned i = 0; i < BATCH; ++i) {
+            iov_[i] = iovec{&bufs_[i * DATAGRAM_MAX], DATAGRAM_MAX};
+            msgs_[i] = mmsghdr{};
+            msgs_[i].msg_hdr.msg_iov = &iov_[i];
+            msgs_[i].msg_hdr.msg_iovlen = 1;
+            msgs_[i].msg_hdr.msg_name = &from_[i];
+        }
+    }
+
+    void run() {
+        for (;;) {
+            if (!upstream_.connected() && nowMs() >= nextConnectMs_) connectUpstream();
+
+            pollfd p{udp_, POLLIN, 0};
+            int r = ::poll(&p, 1, upstream_.connected() ? 100 : 1000);
+            if (r < 0 && errno != EINTR) {
+                std::perror("poll");
+                return;
+            }
+            if (r > 0) drainDatagrams();
+
+            // Keep-alive and PINGRESP/SUBACK draining; the gateway never subscribes
+            if (upstream_.connected() && !upstream_.poll(0, [](const garage::Message*, size_t) {})) {
+                std::fprintf(stderr, "broker connection lost\n");
+            }
+            confirmQueued();
+            report();
+        }
+    }
+
+private:
+    void connectUpstream() {
+        if (upstream_.connect(cfg_.broker, cfg_.brokerPort, 60, cfg_.user, cfg_.pass)) {
+            std::fprintf(stderr, "connected to %s:%u\n", cfg_.broker.c_str(), cfg_.brokerPort);
+            backoffMs_ = 1000;
+            queuedPublishes_ = 0;  // dropped with the old connection's send queue; still in pending_
+            flushPending();
+            return;
+        }
+        nextConnectMs_ = nowMs() + backoffMs_;
+        backoffMs_ = backoffMs_ < 30000 ? backoffMs_ * 2 : 30000;
+    }
+
+    void drainDatagrams() {
+        for (unsigned i = 0; i < BATCH; ++i) msgs_[i].msg_hdr.msg_namelen = sizeof(from_[i]);
+        int n = ::recvmmsg(udp_, msgs_, BATCH, MSG_DONTWAIT, nullptr);
+        if (n <= 0) return;
+
+        items_.clear();
+        for (int i = 0; i < n; ++i) {
+            if (!allowed(cfg_.allow, from_[i].sin6_addr)) {
+                ++stats_.denied;
+                continue;
+            }
+            const uint8_t* d = &bufs_[size_t(i) * DATAGRAM_MAX];
+            mqttsn::Publish pub;
+            if (!mqttsn::parsePublish(d, msgs_[i].msg_len, pub) ||
+                (pub.flags & mqttsn::FLAG_QOS_MINUS1) != mqttsn::FLAG_QOS_MINUS1 ||
+                (pub.flags & 0x03) != mqttsn::TOPIC_PREDEFINED) {
+                ++stats_.rejected;
+                continue;
+            }
+            if (topics_.find(pub.topicId) == topics_.end()) {
+                ++stats_.unknownTopic;
+                continue;
+            }
+            items_.push_back(Item{pub.topicId, pub.data, pub.len, (pub.flags & mqttsn::FLAG_RETAIN) != 0});
+        }
+        if (items_.empty()) return;
+
+        out_.clear();
+        for (const Item& it : items_) append(topics_[it.topicId], it.data, it.len, it.retain);
+        if (send(items_.size())) return;
+        // Not forwarded: the receive buffers are reused, so copy the newest payload per topic
+        for (const Item& it : items_) {
+            pending_[it.topicId] = Pending{std::string(reinterpret_cast<const char*>(it.data), it.len), it.retain};
+        }
+    }
+
+    void flushPending() {
+        if (pending_.empty()) return;
+        out_.clear();
+        for (const auto& [id, p] : pending_) append(topics_[id], p.payload.data(), p.payload.size(), p.retain);
+        if (send(pending_.size())) pending_.clear();
+    }
+
+    void append(const std::string& topic, const void* payload, size_t len, bool retain) {
+        size_t at = out_.size();
+        out_.resize(at + 8 + topic.size() + len);
+        size_t used = mqttpkt::encodePublish(out_.data() + at, out_.size() - at, topic.data(), topic.size(),
+                                             payload, len, retain);
+        out_.resize(at + used);
+    }
+
+    // Writes out_ upstream; false leaves the caller to keep the publishes pending. Bytes the
+    // socket did not take sit in the send queue and are lost if the connection drops, so they
+    // only count as forwarded once the queue has drained
+    bool send(size_t publishes) {
+        if (!upstream_.connected()) return false;
+        if (!upstream_.sendPackets(out_.data(), out_.size())) {
+            std::fprintf(stderr, "broker write failed, keeping %zu publishes\n", publishes);
+            upstream_.close();
+            return false;
+        }
+        queuedPublishes_ += publishes;
+        confirmQueued();
+        return queuedPublishes_ == 0;
+    }
+
+    // Every publish kept in pending_ has been handed to sendPackets() on this connection, so an
+    // empty send queue means all of them have reached the socket
+    void confirmQueued() {
+        if (queuedPublishes_ == 0 || !upstream_.connected() || upstream_.queuedBytes() != 0) return;
+        stats_.forwarded += queuedPublishes_;
+        queuedPublishes_ = 0;
+        pending_.clear();
+    }
+
+    // One line per minute while traffic flows
+    void report() {
+        uint64_t now = nowMs();
+        if (now - lastReportMs_ < 60000) return;
+        lastReportMs_ = now;
+        if (stats_.forwarded == reported_.forwarded && stats_.unknownTopic == reported_.unknownTopic &&
+            stats_.rejected == reported_.rejected && stats_.denied == reported_.denied) {
+            return;
+        }
+        std::fprintf(stderr, "forwarded %llu, unknown topic id %llu, rejected %llu, denied %llu, pending %zu\n",
+                     (unsigned long long)stats_.forwarded, (unsigned long long)stats_.unknownTopic,
+                     (unsigned long long)stats_.rejected, (unsigned long long)stats_.denied, pending_.size());
+        reported_ = stats_;
+    }
+
+    const Config& cfg_;
+    std::unordered_map<uint16_t, std::string> topics_;
+    int udp_;
+    garage::Subscriber upstream_;
+    uint64_t nextConnectMs_ = 0;
+    uint64_t backoffMs_ = 1000;
+    uint64_t queuedPublishes_ = 0;  // sent on this connection, not yet out of the send queue
+
+    std::vector<uint8_t> bufs_;
+    iovec iov_[BATCH];
+    mmsghdr msgs_[BATCH];
+    sockaddr_in6 from_[BATCH];
+    std::vector<Item> items_;
+    std::vector<uint8_t> out_;
+    std::unordered_map<uint16_t, Pending> pending_;  // newest payload per topic not yet confirmed sent
+
+    Stats stats_;
+    Stats reported_;
+    uint64_t lastReportMs_ = 0;
+};
+
+bool parseArgs(int argc, char** argv, Config& cfg) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char* k = argv[i];
+        const char* v = argv[i + 1];
+        if (!std::strcmp(k, "--topics")) cfg.topicsFile = v;
+        else if (!std::strcmp(k, "--port")) cfg.port = uint16_t(std::strtoul(v, nullptr, 10));
+        else if (!std::strcmp(k, "--broker")) cfg.broker = v;
+        else if (!std::strcmp(k, "--broker-port")) cfg.brokerPort = uint16_t(std::strtoul(v, nullptr, 10));
+        else if (!std::strcmp(k, "--user")) cfg.user = v;
+        else if (!std::strcmp(k, "--pass")) cfg.pass = v;
+        else if (!std::strcmp(k, "--allow")) {
+            AllowRule rule;
+            if (!parseAllow(v, rule)) return false;
+            cfg.allow.push_back(rule);
+        }
+        else return false;
+    }
+    return argc % 2 == 1 && !cfg.topicsFile.empty();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Config cfg;
+    if (!parseArgs(argc, argv, cfg)) {
+        std::fprintf(stderr,
+                     "usage: %s --topics FILE [--port 1884] [--broker HOST] [--broker-port 1883]\n"
+                     "          [--user U] [--pass P] [--allow ADDR[/PREFIX]]...\n",
+                     argv[0]);
+        return 2;
+    }
+    std::unordered_map<uint16_t, std::string> topics;
+    if (!loadTopics(cfg.topicsFile, topics)) {
+        std::fprintf(stderr, "cannot read topic IDs from %s\n", cfg.topicsFile.c_str());
+        return 1;
+    }
+    int udp = openUdp(cfg.port);
+    if (udp < 0) {
+        std::perror("udp bind");
+        return 1;
+    }
+    Gateway(cfg, std::move(topics), udp).run();
+    return 1;
+}
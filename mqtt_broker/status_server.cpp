@@ -0,0 +1,331 @@
+// HTTP status endpoint for the fleet
+// - Subscribes to the retained door/online topics and keeps a FleetStateIndex current
+// - Serves StatusSnapshot responses: GET /status (JSON) and GET /status.bin (binary), with ETag/304
+// - One poll() loop over the listener, the broker connection and all HTTP clients; a response
+//   goes straight from the snapshot cache to send(), only an unsent tail is copied
+// - The broker connect (DNS, TCP connect, CONNACK, SUBSCRIBE) runs on a short-lived helper thread
+//   that wakes the loop through a pipe when done, so a slow or silent broker never stalls HTTP
+// - HTTP/1.1 keep-alive; "Connection: close" or HTTP/1.0 closes after the response
+//
+// Usage: status_server [--port 8080] [--broker HOST] [--broker-port 1883] [--topic FILTER]...
+//                      [--user U] [--pass P]
+//        Default topics: +/door and +/door/online
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "fleet_state_index.h"
+#include "status_snapshot.h"
+#include "subscriber.h"
+
+namespace {
+
+const size_t MAX_REQUEST_BYTES = 8192;
+
+const std::string_view NOT_FOUND_RESPONSE = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+const std::string_view BAD_REQUEST_RESPONSE =
+    "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+const std::string_view METHOD_RESPONSE =
+    "HTTP/1.1 405 Method Not Allowed\r\nAllow: GET\r\nContent-Length: 0\r\n\r\n";
+
+struct Config {
+    uint16_t port = 8080;
+    std::string broker = "127.0.0.1";
+    uint16_t brokerPort = 1883;
+    std::vector<std::string> topics;
+    std::string user;
+    std::string pass;
+};
+
+struct Client {
+    int fd;
+    std::string in;
+    std::string out;  // unsent response bytes
+    bool closeAfterWrite = false;
+};
+
+uint64_t nowMs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000 + uint64_t(ts.tv_nsec) / 1000000;
+}
+
+bool equalsNoCase(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        char x = a[i] >= 'A' && a[i] <= 'Z' ? char(a[i] + 32) : a[i];
+        char y = b[i] >= 'A' && b[i] <= 'Z' ? char(b[i] + 32) : b[i];
+        if (x != y) return false;
+    }
+    return true;
+}
+
+// Value of header `name` in the header block, empty if absent
+std::string_view headerValue(std::string_view headers, std::string_view name) {
+    size_t pos = 0;
+    while (pos < headers.size()) {
+        size_t eol = headers.find("\r\n", pos);
+        if (eol == std::string_view::npos) eol = headers.size();
+        std::string_view line = headers.substr(pos, eol - pos);
+        size_t colon = line.find(':');
+        if (colon != std::string_view::npos && equalsNoCase(line.substr(0, colon), name)) {
+            std::string_view v = line.substr(colon + 1);
+            while (!v.empty() && (v.front() == ' ' || v.front() == '\t')) v.remove_prefix(1);
+            return v;
+        }
+        pos = eol + 2;
+    }
+    return {};
+}
+
+int openListener(uint16_t port) {
+    int fd = ::socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    int one = 1;
+    int zero = 0;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+    sockaddr_in6 addr{};
+    addr.sin6_family = AF_INET6;
+    addr.sin6_addr = in6addr_any;
+    addr.sin6_port = htons(port);
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(fd, 1024) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+class Server {
+public:
+    Server(const Config& cfg, int listener, const int wake[2])
+        : cfg_(cfg), listener_(listener), wakeRead_(wake[0]), wakeWrite_(wake[1]), snapshot_(index_),
+          broker_("status-server") {}
+
+    ~Server() {
+        if (connector_.joinable()) connector_.join();
+    }
+
+    void run() {
+        std::vector<pollfd> fds;
+        for (;;) {
+            if (!connecting_ && !broker_.connected() && nowMs() >= nextConnectMs_) startConnect();
+
+            fds.clear();
+            fds.push_back(pollfd{listener_, POLLIN, 0});
+            fds.push_back(pollfd{wakeRead_, POLLIN, 0});
+            if (!connecting_ && broker_.connected()) fds.push_back(pollfd{broker_.fd(), POLLIN, 0});
+            size_t first = fds.size();
+            for (const Client& c : clients_) {
+                fds.push_back(pollfd{c.fd, short(c.out.empty() ? POLLIN : POLLOUT), 0});
+            }
+            if (::poll(fds.data(), fds.size(), 1000) < 0 && errno != EINTR) {
+                std::perror("poll");
+                return;
+            }
+
+            if (fds[1].revents & POLLIN) finishConnect();
+
+            // Apply state before answering, so requests in this round see it
+            if (!connecting_ && broker_.connected()) {
+                broker_.poll(0, [this](const garage::Message* m, size_t n) {
+                    for (size_t i = 0; i < n; ++i) index_.apply(m[i].topic, m[i].payload);
+                });
+            }
+
+            // Walk backwards so removal only moves clients already handled
+            for (size_t i = clients_.size(); i-- > 0;) {
+                short ev = fds[first + i].revents;
+                if (ev == 0) continue;
+                bool keep = (ev & (POLLERR | POLLHUP)) == 0;
+                if (keep && (ev & POLLOUT)) keep = flush(clients_[i]);
+                if (keep && (ev & POLLIN)) keep = readRequests(clients_[i]);
+                if (!keep) {
+                    ::close(clients_[i].fd);
+                    clients_[i] = std::move(clients_.back());
+                    clients_.pop_back();
+                }
+            }
+            if (fds[0].revents & POLLIN) acceptClients();
+        }
+    }
+
+private:
+    // broker_ belongs to the helper thread until finishConnect() has joined it
+    void startConnect() {
+        connecting_ = true;
+        connector_ = std::thread([this] {
+            bool ok = broker_.connect(cfg_.broker, cfg_.brokerPort, 60, cfg_.user, cfg_.pass);
+            for (const std::string& t : cfg_.topics) ok = ok && broker_.subscribe(t);
+            if (!ok) broker_.close();
+            char done = 1;
+            while (::write(wakeWrite_, &done, 1) < 0 && errno == EINTR) {
+            }
+        });
+    }
+
+    void finishConnect() {
+        char buf[16];
+        while (::read(wakeRead_, buf, sizeof(buf)) > 0) {
+        }
+        if (!connecting_) return;
+        connector_.join();
+        connecting_ = false;
+        if (broker_.connected()) {
+            std::fprintf(stderr, "subscribed at %s:%u\n", cfg_.broker.c_str(), cfg_.brokerPort);
+            backoffMs_ = 1000;
+            return;
+        }
+        nextConnectMs_ = nowMs() + backoffMs_;
+        backoffMs_ = backoffMs_ < 30000 ? backoffMs_ * 2 : 30000;
+    }
+
+    void acceptClients() {
+        for (;;) {
+            int fd = ::accept4(listener_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) return;
+            clients_.push_back(Client{fd, {}, {}, false});
+        }
+    }
+
+    bool readRequests(Client& c) {
+        char buf[4096];
+        for (;;) {
+            ssize_t n = ::recv(c.fd, buf, sizeof(buf), 0);
+            if (n == 0) return false;
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN) break;
+                return false;
+            }
+            c.in.append(buf, size_t(n));
+            if (c.in.size() > MAX_REQUEST_BYTES) return false;
+        }
+
+        // Answer every complete request; pipelined requests queue behind an unsent response
+        size_t end;
+        while (!c.closeAfterWrite && (end = c.in.find("\r\n\r\n")) != std::string::npos) {
+            std::string_view req(c.in.data(), end);
+            respond(c, req);
+            c.in.erase(0, end + 4);
+        }
+        return flush(c);
+    }
+
+    void respond(Client& c, std::string_view req) {
+        size_t eol = req.find("\r\n");
+        std::string_view line = req.substr(0, eol);
+        std::string_view headers = eol == std::string_view::npos ? std::string_view() : req.substr(eol + 2);
+
+        size_t sp1 = line.find(' ');
+        size_t sp2 = line.rfind(' ');
+        if (sp1 == std::string_view::npos || sp2 == sp1) {
+            send(c, BAD_REQUEST_RESPONSE);
+            c.closeAfterWrite = true;
+            return;
+        }
+        std::string_view method = line.substr(0, sp1);
+        std::string_view path = line.substr(sp1 + 1, sp2 - sp1 - 1);
+        std::string_view version = line.substr(sp2 + 1);
+        path = path.substr(0, path.find('?'));
+
+        if (version == "HTTP/1.0" || equalsNoCase(headerValue(headers, "Connection"), "close")) {
+            c.closeAfterWrite = true;
+        }
+        if (method != "GET") {
+            send(c, METHOD_RESPONSE);
+        } else if (path == "/status") {
+            send(c, snapshot_.response(garage::StatusSnapshot::Format::Json, headerValue(headers, "If-None-Match")));
+        } else if (path == "/status.bin") {
+            send(c, snapshot_.response(garage::StatusSnapshot::Format::Binary, headerValue(headers, "If-None-Match")));
+        } else {
+            send(c, NOT_FOUND_RESPONSE);
+        }
+    }
+
+    // Writes straight from the cached response when nothing is queued
+    void send(Client& c, std::string_view bytes) {
+        if (c.out.empty()) {
+            ssize_t n = ::send(c.fd, bytes.data(), bytes.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n > 0) bytes.remove_prefix(size_t(n));
+        }
+        c.out.append(bytes.data(), bytes.size());
+    }
+
+    bool flush(Client& c) {
+        if (!c.out.empty()) {
+            ssize_t n = ::send(c.fd, c.out.data(), c.out.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n < 0 && errno != EAGAIN && errno != EINTR) return false;
+            if (n > 0) c.out.erase(0, size_t(n));
+        }
+        return !(c.out.empty() && c.closeAfterWrite);
+    }
+
+    const Config& cfg_;
+    int listener_;
+    int wakeRead_;   // the connect thread writes one byte to wakeWrite_ when it is done
+    int wakeWrite_;
+    garage::FleetStateIndex index_;
+    garage::StatusSnapshot snapshot_;
+    garage::Subscriber broker_;
+    std::thread connector_;
+    bool connecting_ = false;
+    uint64_t nextConnectMs_ = 0;
+    uint64_t backoffMs_ = 1000;
+    std::vector<Client> clients_;
+};
+
+bool parseArgs(int argc, char** argv, Config& cfg) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char* k = argv[i];
+        const char* v = argv[i + 1];
+        if (!std::strcmp(k, "--port")) cfg.port = uint16_t(std::strtoul(v, nullptr, 10));
+        else if (!std::strcmp(k, "--broker")) cfg.broker = v;
+        else if (!std::strcmp(k, "--broker-port")) cfg.brokerPort = uint16_t(std::strtoul(v, nullptr, 10));
+        else if (!std::strcmp(k, "--topic")) cfg.topics.push_back(v);
+        else if (!std::strcmp(k, "--user")) cfg.user = v;
+        else if (!std::strcmp(k, "--pass")) cfg.pass = v;
+        else return false;
+    }
+    if (cfg.topics.empty()) cfg.topics = {"+/door", "+/door/online"};
+    return argc % 2 == 1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Config cfg;
+    if (!parseArgs(argc, argv, cfg)) {
+        std::fprintf(stderr,
+                     "usage: %s [--port 8080] [--broker HOST] [--broker-port 1883] [--topic FILTER]...\n"
+                     "          [--user U] [--pass P]\n",
+                     argv[0]);
+        return 2;
+    }
+    int listener = openListener(cfg.port);
+    if (listener < 0) {
+        std::perror("listen");
+        return 1;
+    }
+    int wake[2];
+    if (pipe2(wake, O_NONBLOCK | O_CLOEXEC) != 0) {
+        std::perror("pipe");
+        return 1;
+    }
+    Server(cfg, listener, wake).run();
+    return 1;
+}
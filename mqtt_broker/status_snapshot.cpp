@@ -0,0 +1,125 @@
+#include "status_snapshot.h"
+
+#include <chrono>
+#include <cstdio>
+
+namespace garage {
+
+namespace {
+
+void appendLe(std::string& out, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        out.push_back(static_cast<char>(v >> (8 * i)));
+    }
+}
+
+void appendJsonString(std::string& out, std::string_view s) {
+    out.push_back('"');
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out.push_back('\\');
+            out.push_back(c);
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char esc[8];
+            std::snprintf(esc, sizeof(esc), "\\u%04x", c);
+            out += esc;
+        } else {
+            out.push_back(c);
+        }
+    }
+    out.push_back('"');
+}
+
+} // namespace
+
+StatusSnapshot::StatusSnapshot(const FleetStateIndex& index)
+    : index_(index),
+      epoch_(static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count())) {}
+
+std::string_view StatusSnapshot::response(Format f, std::string_view ifNoneMatch) {
+    Cached& c = refresh(f);
+    return etagMatches(ifNoneMatch, c.etag) ? c.notModified : c.ok;
+}
+
+bool StatusSnapshot::etagMatches(std::string_view ifNoneMatch, std::string_view etag) {
+    while (!ifNoneMatch.empty()) {
+        size_t comma = ifNoneMatch.find(',');
+        std::string_view tag = ifNoneMatch.substr(0, comma);
+        ifNoneMatch = comma == std::string_view::npos ? std::string_view() : ifNoneMatch.substr(comma + 1);
+
+        while (!tag.empty() && (tag.front() == ' ' || tag.front() == '\t')) tag.remove_prefix(1);
+        while (!tag.empty() && (tag.back() == ' ' || tag.back() == '\t')) tag.remove_suffix(1);
+        if (tag == "*") return true;
+        if (tag.substr(0, 2) == "W/") tag.remove_prefix(2);
+        if (!tag.empty() && tag == etag) return true;
+    }
+    return false;
+}
+
+std::string_view StatusSnapshot::body(Format f) {
+    return refresh(f).body;
+}
+
+std::string_view StatusSnapshot::etag(Format f) {
+    return refresh(f).etag;
+}
+
+StatusSnapshot::Cached& StatusSnapshot::refresh(Format f) {
+    Cached& c = f == Format::Json ? json_ : binary_;
+    if (c.generation == index_.generation()) return c;
+
+    c.generation = index_.generation();
+    c.body.clear();
+    if (f == Format::Json) {
+        buildJson(c.body);
+    } else {
+        buildBinary(c.body);
+    }
+
+    char tag[64];
+    std::snprintf(tag, sizeof(tag), "\"%llx-%llx-%c\"", static_cast<unsigned long long>(epoch_),
+                  static_cast<unsigned long long>(c.generation), f == Format::Json ? 'j' : 'b');
+    c.etag = tag;
+
+    const char* type = f == Format::Json ? "application/json" : "application/octet-stream";
+    c.ok = "HTTP/1.1 200 OK\r\nContent-Type: ";
+    c.ok += type;
+    c.ok += "\r\nCache-Control: no-cache\r\nETag: " + c.etag;
+    c.ok += "\r\nContent-Length: " + std::to_string(c.body.size()) + "\r\n\r\n";
+    c.ok += c.body;
+    c.notModified = "HTTP/1.1 304 Not Modified\r\nETag: " + c.etag + "\r\n\r\n";
+    return c;
+}
+
+// {"generation":N,"counts":{...},"devices":[{"id":"garage","open":true,"online":true},...]}
+// Array position is the device number used by the binary format.
+void StatusSnapshot::buildJson(std::string& out) const {
+    using Q = FleetStateIndex::Query;
+    out += "{\"generation\":" + std::to_string(index_.generation());
+    out += ",\"counts\":{\"open\":" + std::to_string(index_.count(Q::Open));
+    out += ",\"online\":" + std::to_string(index_.count(Q::Online));
+    out += ",\"onlineOpen\":" + std::to_string(index_.count(Q::OnlineOpen));
+    out += ",\"offlineOpen\":" + std::to_string(index_.count(Q::OfflineOpen));
+    out += "},\"devices\":[";
+    for (uint32_t dev = 0; dev < index_.deviceCount(); ++dev) {
+        if (dev) out.push_back(',');
+        out += "{\"id\":";
+        appendJsonString(out, index_.deviceName(dev));
+        out += index_.isOpen(dev) ? ",\"open\":true" : ",\"open\":false";
+        out += index_.isOnline(dev) ? ",\"online\":true}" : ",\"online\":false}";
+    }
+    out += "]}";
+}
+
+// "GDS1", u32 device count, u32 word count, open words, online words; all little-endian.
+void StatusSnapshot::buildBinary(std::string& out) const {
+    const auto& open = index_.openBits();
+    const auto& online = index_.onlineBits();
+    out += "GDS1";
+    appendLe(out, index_.deviceCount(), 4);
+    appendLe(out, open.size(), 4);
+    for (uint64_t w : open) appendLe(out, w, 8);
+    for (uint64_t w : online) appendLe(out, w, 8);
+}
+
+} // namespace garage
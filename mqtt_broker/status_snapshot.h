@@ -0,0 +1,52 @@
+// Cached fleet status snapshots for HTTP polling
+// - Serialises a FleetStateIndex to JSON or a compact binary form
+// - Keeps complete pre-built HTTP/1.1 responses (200 and 304) per format
+// - Rebuilds only when the index generation changes, so repeated polls are a lookup and a write
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "fleet_state_index.h"
+
+namespace garage {
+
+class StatusSnapshot {
+public:
+    enum class Format { Json, Binary };
+
+    explicit StatusSnapshot(const FleetStateIndex& index);
+
+    // Full response bytes for a GET: 304 when ifNoneMatch matches the current ETag, otherwise 200.
+    // The view stays valid until the next call that observes a newer index generation.
+    std::string_view response(Format f, std::string_view ifNoneMatch = {});
+
+    std::string_view body(Format f);
+    std::string_view etag(Format f);
+
+    // If-None-Match comparison (RFC 9110): a comma-separated list of entity tags or "*";
+    // weak tags (W/"...") match the strong tag with the same value.
+    static bool etagMatches(std::string_view ifNoneMatch, std::string_view etag);
+
+private:
+    struct Cached {
+        uint64_t generation = UINT64_MAX;
+        std::string etag;
+        std::string body;
+        std::string ok;           // 200 response including body
+        std::string notModified;  // 304 response
+    };
+
+    Cached& refresh(Format f);
+    void buildJson(std::string& out) const;
+    void buildBinary(std::string& out) const;
+
+    const FleetStateIndex& index_;
+    uint64_t epoch_;  // distinguishes ETags across process restarts
+    Cached json_;
+    Cached binary_;
+};
+
+} // namespace garage
@@ -0,0 +1,327 @@
+#include "subscriber.h"
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../esp8266/lib/mqtt_packets/mqtt_packets.h"
+
+namespace garage {
+
+namespace {
+
+uint64_t nowMs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000 + uint64_t(ts.tv_nsec) / 1000000;
+}
+
+} // namespace
+
+int parseStatus(std::string_view payload) {
+    if (payload == "open" || payload == "true") return 1;
+    if (payload == "closed" || payload == "false") return 0;
+    return -1;
+}
+
+Subscriber::Subscriber(std::string clientId, size_t bufferSize)
+    : clientId_(std::move(clientId)), bufferSize_(bufferSize) {}
+
+Subscriber::~Subscriber() {
+    close();
+}
+
+void Subscriber::close() {
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+    fill_ = 0;
+    pingSentMs_ = 0;
+    sendQueue_.clear();
+    buf_.reset();
+    capacity_ = 0;
+}
+
+size_t Subscriber::memoryBytes() const {
+    // seen_: the bucket array stays allocated across clear(); each live node holds a next pointer,
+    // the view and the cached hash
+    size_t seenBytes = seen_.bucket_count() * sizeof(void*) +
+                       seen_.size() * (sizeof(void*) + sizeof(std::string_view) + sizeof(size_t));
+    return capacity_ + batch_.capacity() * sizeof(Message) + out_.capacity() + sendQueue_.capacity() +
+           seenBytes;
+}
+
+void Subscriber::releaseIdleBuffers() {
+    if (idleReleaseMs_ == 0 || capacity_ == 0 || fill_ != 0) return;
+    if (nowMs() - lastRecvMs_ < idleReleaseMs_) return;
+    buf_.reset();
+    capacity_ = 0;
+    std::vector<Message>().swap(batch_);
+    std::unordered_set<std::string_view>().swap(seen_);
+    std::vector<uint8_t>().swap(out_);
+    if (sendQueue_.empty()) std::vector<uint8_t>().swap(sendQueue_);
+}
+
+bool Subscriber::connect(const std::string& host, uint16_t port, uint16_t keepAliveSec,
+                         const std::string& user, const std::string& pass) {
+    close();
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* res = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &res) != 0) return false;
+
+    // Non-blocking connect: a silent host costs the connect timeout, not the kernel's SYN retries
+    uint64_t deadline = nowMs() + connectTimeoutMs_;
+    auto remaining = [&] { uint64_t now = nowMs(); return now >= deadline ? 0 : int(deadline - now); };
+    for (addrinfo* ai = res; ai && fd_ < 0; ai = ai->ai_next) {
+        int fd = ::socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) continue;
+        int err = ::connect(fd, ai->ai_addr, ai->ai_addrlen) == 0 ? 0 : errno;
+        if (err == EINPROGRESS) {
+            pollfd p{fd, POLLOUT, 0};
+            socklen_t errLen = sizeof(err);
+            if (::poll(&p, 1, remaining()) != 1 || getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &errLen) != 0) {
+                err = ETIMEDOUT;
+            }
+        }
+        if (err == 0) {
+            fd_ = fd;
+        } else {
+            ::close(fd);
+        }
+    }
+    freeaddrinfo(res);
+    if (fd_ < 0) return false;
+
+    int one = 1;
+    setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    // CONNECT, clean session, optional username/password
+    std::vector<uint8_t> pkt(64 + clientId_.size() + user.size() + pass.size());
+    size_t len = mqttpkt::encodeConnect(pkt.data(), pkt.size(), clientId_.c_str(), keepAliveSec, true,
+                                     user.empty() ? nullptr : user.c_str(),
+                                     user.empty() ? nullptr : pass.c_str());
+    keepAliveSec_ = keepAliveSec;
+    if (!sendAll(pkt.data(), len)) {
+        close();
+        return false;
+    }
+
+    uint8_t ack[4];
+    size_t got = 0;
+    while (got < sizeof(ack)) {
+        pollfd p{fd_, short(POLLIN | (sendQueue_.empty() ? 0 : POLLOUT)), 0};
+        int r = ::poll(&p, 1, remaining());
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0 || ((p.revents & POLLOUT) && !flushQueue())) {
+            close();
+            return false;
+        }
+        if (!(p.revents & (POLLIN | POLLHUP | POLLERR))) continue;
+        ssize_t n = ::recv(fd_, ack + got, sizeof(ack) - got, MSG_DONTWAIT);
+        if (n <= 0) {
+            if (n < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+            close();
+            return false;
+        }
+        got += size_t(n);
+    }
+    if (ack[0] != mqttpkt::CONNACK || ack[1] != 2 || ack[3] != 0) {
+        close();
+        return false;
+    }
+    lastRecvMs_ = nowMs();
+    return true;
+}
+
+void Subscriber::attach(int fd, uint16_t keepAliveSec) {
+    close();
+    fd_ = fd;
+    keepAliveSec_ = keepAliveSec;
+    lastSendMs_ = lastRecvMs_ = nowMs();
+}
+
+bool Subscriber::subscribe(std::string_view filter) {
+    if (fd_ < 0) return false;
+    uint16_t id = nextPacketId_++;
+    if (nextPacketId_ == 0) nextPacketId_ = 1;
+    std::vector<uint8_t> pkt(16 + filter.size());
+    size_t len = mqttpkt::encodeSubscribe(pkt.data(), pkt.size(), id, filter.data(), filter.size(), 0);
+    return sendAll(pkt.data(), len);
+}
+
+bool Subscriber::sendAll(const uint8_t* data, size_t len) {
+    // Behind a queued tail the bytes must wait their turn; otherwise the socket takes what it can
+    if (sendQueue_.empty()) {
+        while (len > 0) {
+            ssize_t n = ::send(fd_, data, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN) break;
+                return false;
+            }
+            data += n;
+            len -= size_t(n);
+        }
+    }
+    if (len > 0) {
+        if (sendQueue_.size() + len > sendQueueLimit_) return false;
+        sendQueue_.insert(sendQueue_.end(), data, data + len);
+    }
+    lastSendMs_ = nowMs();
+    return true;
+}
+
+bool Subscriber::flushQueue() {
+    while (!sendQueue_.empty()) {
+        ssize_t n = ::send(fd_, sendQueue_.data(), sendQueue_.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN;
+        }
+        sendQueue_.erase(sendQueue_.begin(), sendQueue_.begin() + n);
+    }
+    return true;
+}
+
+bool Subscriber::flushOut() {
+    if (out_.empty()) return true;
+    bool ok = sendAll(out_.data(), out_.size());
+    out_.clear();
+    return ok;
+}
+
+bool Subscriber::poll(int timeoutMs, const BatchHandler& handler) {
+    if (fd_ < 0) return false;
+
+    if (keepAliveSec_ > 0) {
+        uint64_t now = nowMs();
+        uint64_t half = uint64_t(keepAliveSec_) * 500;
+        if (pingSentMs_ != 0 && now - lastRecvMs_ >= half * 3) {
+            close();  // no PINGRESP within 1.5x keep-alive: the path is dead even if sends succeed
+            return false;
+        }
+        if (pingSentMs_ == 0 && (now - lastSendMs_ >= half || now - lastRecvMs_ >= half)) {
+            if (!sendAll(mqttpkt::PINGREQ_PACKET, sizeof(mqttpkt::PINGREQ_PACKET))) {
+                close();
+                return false;
+            }
+            pingSentMs_ = now;
+        } else if (now - lastSendMs_ >= half) {
+            // A PINGREQ is outstanding; keep the broker's side of the keep-alive fed regardless
+            if (!sendAll(mqttpkt::PINGREQ_PACKET, sizeof(mqttpkt::PINGREQ_PACKET))) {
+                close();
+                return false;
+            }
+        }
+    }
+
+    pollfd p{fd_, short(POLLIN | (sendQueue_.empty() ? 0 : POLLOUT)), 0};
+    int r = ::poll(&p, 1, timeoutMs);
+    if (r <= 0) {
+        releaseIdleBuffers();
+        return r == 0 || errno == EINTR;
+    }
+    if ((p.revents & POLLOUT) && !flushQueue()) {
+        close();
+        return false;
+    }
+    if (!(p.revents & (POLLIN | POLLHUP | POLLERR))) return true;
+
+    // Attach a buffer only once the socket is readable; grow when one packet exceeds it
+    if (capacity_ == 0 || fill_ == capacity_) {
+        size_t grown = capacity_ == 0 ? bufferSize_ : capacity_ * 2;
+        std::unique_ptr<char[]> bigger(new char[grown]);
+        if (fill_ > 0) std::memcpy(bigger.get(), buf_.get(), fill_);
+        buf_ = std::move(bigger);
+        capacity_ = grown;
+    }
+    ssize_t n = ::recv(fd_, buf_.get() + fill_, capacity_ - fill_, MSG_DONTWAIT);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+        close();
+        return false;
+    }
+    if (n < 0) return true;
+    fill_ += size_t(n);
+    lastRecvMs_ = nowMs();
+
+    if (!parsePackets(handler) || !flushOut()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool Subscriber::parsePackets(const BatchHandler& handler) {
+    const uint8_t* base = reinterpret_cast<const uint8_t*>(buf_.get());
+    size_t pos = 0;
+    batch_.clear();
+
+    while (pos < fill_) {
+        const uint8_t* p = base + pos;
+        size_t remaining;
+        int hdr = mqttpkt::decodeHeader(p, fill_ - pos, remaining);
+        if (hdr < 0) return false;
+        if (hdr == 0 || fill_ - pos < hdr + remaining) break;  // incomplete packet
+
+        const uint8_t* body = p + hdr;
+        uint8_t type = p[0] & 0xF0;
+        if (type == mqttpkt::PUBLISH) {
+            uint8_t qos = (p[0] >> 1) & 0x03;
+            if (remaining < 2 || qos > 1) return false;
+            size_t topicLen = (size_t(body[0]) << 8) | body[1];
+            size_t off = 2 + topicLen;
+            if (off + (qos ? 2 : 0) > remaining) return false;
+            if (qos == 1) {
+                uint8_t ack[4];
+                mqttpkt::encodePuback(ack, uint16_t((body[off] << 8) | body[off + 1]));
+                out_.insert(out_.end(), ack, ack + sizeof(ack));
+                off += 2;
+            }
+            Message m;
+            m.topic = std::string_view(reinterpret_cast<const char*>(body + 2), topicLen);
+            m.payload = std::string_view(reinterpret_cast<const char*>(body + off), remaining - off);
+            m.qos = qos;
+            m.retained = (p[0] & 0x01) != 0;
+            batch_.push_back(m);
+        } else if (type == mqttpkt::PUBACK) {
+            if (remaining < 2) return false;
+            if (onAck_) onAck_(uint16_t((body[0] << 8) | body[1]));
+        } else if (type == mqttpkt::PINGRESP) {
+            pingSentMs_ = 0;
+        } else if (type != mqttpkt::SUBACK) {
+            return false;
+        }
+        pos += hdr + remaining;
+    }
+
+    if (conflate_ && batch_.size() > 1) conflateBatch();
+    if (!batch_.empty()) handler(batch_.data(), batch_.size());
+
+    // Keep the partial packet at the front for the next read
+    if (pos > 0) {
+        std::memmove(buf_.get(), buf_.get() + pos, fill_ - pos);
+        fill_ -= pos;
+    }
+    return true;
+}
+
+// Keeps the last message of each topic, in the order those last messages arrived
+void Subscriber::conflateBatch() {
+    seen_.clear();
+    size_t keep = batch_.size();
+    for (size_t i = batch_.size(); i-- > 0;) {
+        if (seen_.insert(batch_[i].topic).second) batch_[--keep] = batch_[i];
+    }
+    batch_.erase(batch_.begin(), batch_.begin() + keep);
+}
+
+} // namespace garage
@@ -0,0 +1,125 @@
+// Zero-copy MQTT 3.1.1 subscriber for backend consumers
+// - Topics and payloads are delivered as string_views into the receive buffer
+// - All complete PUBLISH packets from one read are handed to the callback as one batch
+// - Views are valid only for the duration of the callback; copy what you keep
+// - The receive buffer is allocated when data arrives and released after it drains and the
+//   connection stays quiet, so idle subscribers hold no buffer memory
+// - Optional latest-value conflation: a consumer that falls behind gets one message per topic
+//   per batch (the newest) instead of the whole backlog
+// - Never blocks past a deadline: connect() is bounded by the connect timeout, sends that the
+//   socket does not take are queued and flushed by poll(), and a PINGREQ left unanswered for
+//   1.5x the keep-alive closes the connection
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace garage {
+
+struct Message {
+    std::string_view topic;
+    std::string_view payload;
+    uint8_t qos;
+    bool retained;
+};
+
+// Door/online payloads as a tri-state: 1 = "open"/"true", 0 = "closed"/"false", -1 = unknown.
+// Same vocabulary as FleetStateIndex::apply().
+int parseStatus(std::string_view payload);
+
+class Subscriber {
+public:
+    using BatchHandler = std::function<void(const Message* msgs, size_t count)>;
+    using AckHandler = std::function<void(uint16_t packetId)>;
+
+    explicit Subscriber(std::string clientId, size_t bufferSize = 256 * 1024);
+    ~Subscriber();
+
+    Subscriber(const Subscriber&) = delete;
+    Subscriber& operator=(const Subscriber&) = delete;
+
+    // TCP connect plus CONNECT/CONNACK, together bounded by the connect timeout.
+    // Empty user means no credentials.
+    bool connect(const std::string& host, uint16_t port, uint16_t keepAliveSec = 60,
+                 const std::string& user = "", const std::string& pass = "");
+
+    // Takes over a connected socket whose CONNECT/CONNACK exchange is already done, e.g. one end
+    // of a socketpair in tests
+    void attach(int fd, uint16_t keepAliveSec);
+
+    // QoS 0 subscription; SUBACK is consumed by poll().
+    // A shared filter ("$share/<group>/+/door") is passed through to the broker as-is. Brokers do
+    // not send retained messages to shared subscriptions, so a worker that needs current state must
+    // also read it once through a plain subscription.
+    bool subscribe(std::string_view filter);
+
+    // Wait up to timeoutMs for data, read once, deliver every complete PUBLISH as one batch.
+    // Sends PINGREQ when either direction has been quiet for half the keep-alive, and closes the
+    // connection when no PINGRESP arrives within 1.5x the keep-alive. Flushes queued sends.
+    // Returns false when the connection is closed or a protocol error occurs.
+    bool poll(int timeoutMs, const BatchHandler& handler);
+
+    // Writes already-encoded packets (e.g. a run of PUBLISHes) as-is in one send. What the socket
+    // does not take is queued for poll(); false when the queue would exceed the send-queue limit.
+    bool sendPackets(const uint8_t* data, size_t len) { return fd_ >= 0 && sendAll(data, len); }
+
+    // Called from poll() for each PUBACK, for callers that publish at QoS 1 through sendPackets()
+    void setAckHandler(AckHandler handler) { onAck_ = std::move(handler); }
+
+    void setConnectTimeout(uint32_t ms) { connectTimeoutMs_ = ms; }
+    void setSendQueueLimit(size_t bytes) { sendQueueLimit_ = bytes; }
+    size_t queuedBytes() const { return sendQueue_.size(); }
+
+    void close();
+    bool connected() const { return fd_ >= 0; }
+    int fd() const { return fd_; }
+
+    // Deliver only the newest message per topic within each batch. Meant for state topics like
+    // <device>/door where only the latest value matters; QoS 1 messages are still acknowledged.
+    void setConflate(bool on) { conflate_ = on; }
+
+    // Release the drained receive buffer after this long without incoming data (0 = keep it).
+    void setIdleRelease(uint32_t ms) { idleReleaseMs_ = ms; }
+
+    // Heap bytes currently held for this connection's buffers
+    size_t memoryBytes() const;
+
+private:
+    bool sendAll(const uint8_t* data, size_t len);
+    bool flushQueue();
+    bool flushOut();
+    bool parsePackets(const BatchHandler& handler);
+    void releaseIdleBuffers();
+    void conflateBatch();
+
+    std::string clientId_;
+    int fd_ = -1;
+    uint16_t keepAliveSec_ = 0;
+    uint16_t nextPacketId_ = 1;
+    uint64_t lastSendMs_ = 0;
+    uint64_t lastRecvMs_ = 0;
+    uint64_t pingSentMs_ = 0;  // outstanding PINGREQ, 0 = none
+    uint32_t connectTimeoutMs_ = 5000;
+    size_t sendQueueLimit_ = 1 << 20;
+    uint32_t idleReleaseMs_ = 30000;
+    bool conflate_ = false;
+
+    size_t bufferSize_;
+    std::unique_ptr<char[]> buf_;  // receive buffer; [0, fill_) holds unparsed bytes
+    size_t capacity_ = 0;          // 0 while released
+    size_t fill_ = 0;
+    std::vector<Message> batch_;
+    std::unordered_set<std::string_view> seen_;  // conflation scratch, reused across batches
+    std::vector<uint8_t> out_;  // PUBACKs queued during one parse pass
+    std::vector<uint8_t> sendQueue_;  // bytes the socket has not taken yet
+    AckHandler onAck_;
+};
+
+} // namespace garage
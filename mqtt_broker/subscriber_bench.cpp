@@ -0,0 +1,106 @@
+// Subscriber throughput on one core: how fast a full-fleet +/door feed is parsed and delivered
+// - N devices, M retained "<site>/esp-<hex>/door" publishes ("open"/"closed") pre-encoded once
+// - A writer thread pushes them through a socketpair in 64 KiB writes; the subscriber thread
+//   polls and copies nothing, the handler only counts (and tallies open doors to use the payload)
+// - Reports messages/s and MB/s for plain and conflated delivery
+//
+// Usage: subscriber_bench [--devices N] [--messages M]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../esp8266/lib/mqtt_packets/mqtt_packets.h"
+#include "subscriber.h"
+
+namespace {
+
+struct Config {
+    size_t devices = 100000;
+    size_t messages = 5000000;
+};
+
+std::vector<uint8_t> encodeFeed(const Config& cfg) {
+    std::vector<uint8_t> feed;
+    feed.reserve(cfg.messages * 32);
+    uint8_t pkt[64];
+    char topic[48];
+    for (size_t i = 0; i < cfg.messages; ++i) {
+        size_t dev = (i * 2654435761u) % cfg.devices;
+        int len = std::snprintf(topic, sizeof(topic), "site-%02zu/esp-%06zx/door", dev % 50, dev);
+        const char* payload = i % 3 == 0 ? "open" : "closed";
+        size_t n = mqttpkt::encodePublish(pkt, sizeof(pkt), topic, size_t(len), payload, std::strlen(payload), true);
+        feed.insert(feed.end(), pkt, pkt + n);
+    }
+    return feed;
+}
+
+void run(const char* name, const std::vector<uint8_t>& feed, size_t messages, bool conflate) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {
+        std::perror("socketpair");
+        std::exit(1);
+    }
+    garage::Subscriber sub("bench");
+    sub.setConflate(conflate);
+    sub.attach(fds[0], 0);
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread writer([&] {
+        for (size_t at = 0; at < feed.size();) {
+            ssize_t n = ::send(fds[1], feed.data() + at, std::min<size_t>(65536, feed.size() - at), 0);
+            if (n <= 0) break;
+            at += size_t(n);
+        }
+        ::shutdown(fds[1], SHUT_WR);
+    });
+
+    size_t delivered = 0;
+    size_t open = 0;
+    while (sub.poll(1000, [&](const garage::Message* m, size_t n) {
+        delivered += n;
+        for (size_t i = 0; i < n; ++i) open += m[i].payload.size() == 4;
+    })) {
+    }
+    writer.join();
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    ::close(fds[1]);
+
+    std::printf("%-10s %6.2f M msg/s  %7.1f MB/s  (%zu delivered, %zu open)\n", name,
+                double(messages) / sec / 1e6, double(feed.size()) / sec / 1e6, delivered, open);
+}
+
+bool parseArgs(int argc, char** argv, Config& cfg) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char* k = argv[i];
+        const char* v = argv[i + 1];
+        if (!std::strcmp(k, "--devices")) cfg.devices = std::strtoull(v, nullptr, 10);
+        else if (!std::strcmp(k, "--messages")) cfg.messages = std::strtoull(v, nullptr, 10);
+        else return false;
+    }
+    return argc % 2 == 1 && cfg.devices > 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Config cfg;
+    if (!parseArgs(argc, argv, cfg)) {
+        std::fprintf(stderr, "usage: %s [--devices N] [--messages M]\n", argv[0]);
+        return 2;
+    }
+    std::vector<uint8_t> feed = encodeFeed(cfg);
+    std::printf("%zu devices, %zu messages, %.1f MB\n", cfg.devices, cfg.messages, double(feed.size()) / 1e6);
+    run("plain", feed, cfg.messages, false);
+    run("conflated", feed, cfg.messages, true);
+    return 0;
+}
@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+"""bridge: hostname client ID and per-side credentials, QoS 1 forwarding, spooling through
+outages and restarts, PUBACK-gated truncation, PINGRESP deadline on a hung upstream.
+
+Usage: bridge_test.py <path to bridge>
+"""
+import os
+import signal
+import socket
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+from fake_broker import FakeBroker
+
+KEEPALIVE = 2
+
+
+def spool_records(path):
+    """(topic, payload, flags) per record; [] when the file is missing."""
+    if not os.path.exists(path):
+        return []
+    data = open(path, 'rb').read()
+    out, pos = [], 0
+    while pos + 7 <= len(data):
+        flags, tl, pl = struct.unpack_from('<BHI', data, pos)
+        pos += 7
+        out.append((data[pos:pos + tl].decode(), data[pos + tl:pos + tl + pl], flags))
+        pos += tl + pl
+    return out
+
+
+def main():
+    binary = sys.argv[1]
+    failures = []
+
+    def check(name, ok):
+        if not ok:
+            failures.append(name)
+            print('FAIL', name)
+
+    with tempfile.TemporaryDirectory() as tmp:
+        spool = os.path.join(tmp, 'spool')
+        local, upstream = FakeBroker(), FakeBroker()
+        args = [binary, '--local-port', str(local.port), '--remote-port', str(upstream.port),
+                '--remote', '127.0.0.1', '--state', '+/door', '--event', '+/log', '--prefix', 'site/',
+                '--spool', spool, '--keepalive', str(KEEPALIVE),
+                '--user', 'central', '--pass', 'c', '--local-user', 'site', '--local-pass', 's']
+        bridge = None
+
+        def start_bridge():
+            subs = len(local.subs)
+            p = subprocess.Popen(args)
+            check('local subscriptions', local.wait_for(lambda: len(local.subs) >= subs + 2))
+            return p
+
+        def events():
+            return [p for _, p, _, _ in upstream.messages('site/g/log')]
+
+        def state():
+            m = upstream.messages('site/g/door')
+            return m[-1] if m else None
+
+        try:
+            bridge = start_bridge()
+            check('upstream connected', upstream.wait_for(lambda: len(upstream.client_ids) == 1))
+
+            # Client ID from the hostname; each broker gets its own credentials
+            client_id = 'bridge-' + socket.gethostname()
+            check('client ID from hostname', upstream.client_ids == [client_id])
+            check('local client IDs', sorted(local.client_ids) == [client_id + '-events', client_id + '-state'])
+            check('upstream credentials', upstream.users == ['central'])
+            check('local credentials', local.users == ['site', 'site'])
+
+            # Connected: republished upstream at QoS 1, states retained
+            local.publish('g/door', b'open', retain=True)
+            local.publish('g/log', b'e0')
+            check('live forward', upstream.wait_for(lambda: state() is not None and events() == [b'e0']))
+            check('live QoS 1 and retain', state() == ('site/g/door', b'open', True, 1))
+
+            # Outage: events appended in order, states compacted to one record per topic
+            upstream.stop()
+            time.sleep(0.5)
+            for v in (b'closed', b'open', b'closed'):
+                local.publish('g/door', v, retain=True)
+                local.publish('g/log', b'e' + v)
+                time.sleep(0.1)
+            time.sleep(0.5)
+            check('events spooled in order',
+                  [p for _, p, _ in spool_records(spool)] == [b'eclosed', b'eopen', b'eclosed'])
+            check('state spooled once per topic',
+                  spool_records(spool + '.state') == [('site/g/door', b'closed', 3)])
+
+            # A restarted bridge picks the spool up and replays it after reconnecting
+            bridge.send_signal(signal.SIGKILL)
+            bridge.wait()
+            bridge = start_bridge()
+            upstream.start()
+            check('spool replayed after restart',
+                  upstream.wait_for(lambda: events() == [b'e0', b'eclosed', b'eopen', b'eclosed']))
+            check('replayed state is newest', upstream.wait_for(lambda: state()[1] == b'closed'))
+            check('spool truncated once acknowledged',
+                  upstream.wait_for(lambda: spool_records(spool) == [] and
+                                    not os.path.exists(spool + '.state')))
+
+            # Replayed but never acknowledged: the spool is kept and replayed again
+            upstream.stop()
+            time.sleep(0.5)
+            local.publish('g/log', b'e4')
+            check('spooled during second outage', upstream.wait_for(lambda: len(spool_records(spool)) == 1, 3))
+            upstream.ack_qos1 = False
+            upstream.start()
+            check('replay without PUBACK', upstream.wait_for(lambda: events()[-1:] == [b'e4']))
+            time.sleep(0.5)
+            check('unacknowledged spool kept', [p for _, p, _ in spool_records(spool)] == [b'e4'])
+            upstream.stop()
+            upstream.ack_qos1 = True
+            upstream.start()
+            check('replayed again', upstream.wait_for(lambda: events()[-2:] == [b'e4', b'e4']))
+            check('truncated after PUBACK', upstream.wait_for(lambda: spool_records(spool) == []))
+
+            # Hung upstream: writes still succeed, but no PUBACK or PINGRESP comes back within
+            # 1.5x the keep-alive, so the bridge fails over to the spool
+            upstream.hang()
+            local.publish('g/log', b'e5')
+            check('hung upstream detected',
+                  upstream.wait_for(lambda: [p for _, p, _ in spool_records(spool)] == [b'e5'],
+                                    KEEPALIVE * 3))
+            check('local connections kept', bridge.poll() is None and len(local.conns) >= 2)
+            upstream.stop()
+            upstream.start()
+            check('delivered after hang', upstream.wait_for(lambda: events()[-1:] == [b'e5']))
+            check('truncated after hang', upstream.wait_for(lambda: spool_records(spool) == []))
+        finally:
+            if bridge:
+                bridge.kill()
+                bridge.wait()
+            local.stop()
+            upstream.stop()
+
+    return 1 if failures else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,20 @@
+// Minimal check macro for the host tests: unlike assert() it stays active in Release builds
+// and keeps going after a failure, so one run reports every broken check.
+
+#pragma once
+
+#include <cstdio>
+
+namespace checks {
+inline int failures = 0;
+}
+
+#define CHECK(cond)                                                           \
+    do {                                                                      \
+        if (!(cond)) {                                                        \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            ++checks::failures;                                               \
+        }                                                                     \
+    } while (0)
+
+#define CHECK_DONE() (checks::failures == 0 ? 0 : (std::fprintf(stderr, "%d check(s) failed\n", checks::failures), 1))
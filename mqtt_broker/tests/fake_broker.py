@@ -0,0 +1,193 @@
+"""Scripted MQTT 3.1.1 broker for the daemon tests.
+
+Enough of the protocol for the tools in mqtt_broker/: CONNECT/CONNACK, SUBSCRIBE/SUBACK,
+PUBLISH QoS 0/1 with PUBACK, PINGREQ/PINGRESP. Retained messages are kept per topic and
+sent to matching new subscriptions. Faults: stop() drops every connection and the listener
+(connection refused), hang() keeps sockets open but stops reading and answering.
+"""
+import socket
+import struct
+import threading
+import time
+
+
+def topic_matches(filt, topic):
+    f, t = filt.split('/'), topic.split('/')
+    for i, part in enumerate(f):
+        if part == '#':
+            return True
+        if i >= len(t) or (part != '+' and part != t[i]):
+            return False
+    return len(f) == len(t)
+
+
+def encode_length(n):
+    out = bytearray()
+    while True:
+        b = n % 128
+        n //= 128
+        out.append(b | (0x80 if n else 0))
+        if not n:
+            return bytes(out)
+
+
+def publish_packet(topic, payload, retain=False, qos=0, packet_id=0):
+    t = topic.encode()
+    body = struct.pack('>H', len(t)) + t + (struct.pack('>H', packet_id) if qos else b'') + payload
+    return bytes([0x30 | (qos << 1) | (1 if retain else 0)]) + encode_length(len(body)) + body
+
+
+class FakeBroker:
+    def __init__(self, port=0, ack_qos1=True):
+        self.port = port
+        self.ack_qos1 = ack_qos1
+        self.lock = threading.Lock()
+        self.received = []        # (topic, payload, retain, qos) in arrival order
+        self.retained = {}
+        self.client_ids = []
+        self.users = []           # CONNECT username per connect, None without one
+        self.subs = []            # (conn, filter)
+        self.conns = []
+        self.hung = False
+        self.server = None
+        self.start()
+
+    # ---------- control ----------
+    def start(self):
+        self.server = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        self.server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.server.bind(('127.0.0.1', self.port))
+        self.port = self.server.getsockname()[1]
+        self.server.listen(16)
+        self.hung = False
+        threading.Thread(target=self._accept, args=(self.server,), daemon=True).start()
+
+    def stop(self):
+        with self.lock:
+            conns, self.conns, self.subs = self.conns, [], []
+        try:
+            self.server.shutdown(socket.SHUT_RDWR)  # wakes the blocked accept()
+        except OSError:
+            pass
+        self.server.close()
+        for c in conns:
+            try:
+                c.shutdown(socket.SHUT_RDWR)
+            except OSError:
+                pass
+            c.close()
+
+    def hang(self):
+        self.hung = True
+
+    def publish(self, topic, payload, retain=False):
+        """Publish as if from another client: deliver to matching subscribers."""
+        with self.lock:
+            if retain:
+                self.retained[topic] = payload
+            targets = [c for c, f in self.subs if topic_matches(f, topic)]
+        for c in targets:
+            try:
+                c.sendall(publish_packet(topic, payload))
+            except OSError:
+                pass
+
+    def messages(self, prefix=''):
+        with self.lock:
+            return [m for m in self.received if m[0].startswith(prefix)]
+
+    def wait_for(self, predicate, timeout=10.0):
+        deadline = time.time() + timeout
+        while time.time() < deadline:
+            if predicate():
+                return True
+            time.sleep(0.02)
+        return predicate()
+
+    # ---------- protocol ----------
+    def _accept(self, server):
+        while True:
+            try:
+                c, _ = server.accept()
+            except OSError:
+                return
+            with self.lock:
+                self.conns.append(c)
+            threading.Thread(target=self._serve, args=(c,), daemon=True).start()
+
+    def _serve(self, c):
+        buf = b''
+        try:
+            while True:
+                while self.hung:
+                    time.sleep(0.05)
+                data = c.recv(65536)
+                if not data:
+                    return
+                buf += data
+                while True:
+                    pkt, buf = self._split(buf)
+                    if pkt is None:
+                        break
+                    if not self.hung:
+                        self._handle(c, pkt)
+        except OSError:
+            return
+
+    @staticmethod
+    def _split(buf):
+        if len(buf) < 2:
+            return None, buf
+        n, mult, i = 0, 1, 1
+        while True:
+            if i >= len(buf):
+                return None, buf
+            n += (buf[i] & 0x7F) * mult
+            mult *= 128
+            i += 1
+            if not buf[i - 1] & 0x80:
+                break
+        if len(buf) < i + n:
+            return None, buf
+        return (buf[0], buf[i:i + n]), buf[i + n:]
+
+    def _handle(self, c, pkt):
+        kind, body = pkt
+        t = kind & 0xF0
+        if t == 0x10:
+            flags = body[7]
+            id_len = struct.unpack('>H', body[10:12])[0]
+            pos = 12 + id_len
+            for _ in range(2 if flags & 0x04 else 0):  # will topic and message
+                pos += 2 + struct.unpack('>H', body[pos:pos + 2])[0]
+            user = None
+            if flags & 0x80:
+                user_len = struct.unpack('>H', body[pos:pos + 2])[0]
+                user = body[pos + 2:pos + 2 + user_len].decode()
+            with self.lock:
+                self.client_ids.append(body[12:12 + id_len].decode())
+                self.users.append(user)
+            c.sendall(b'\x20\x02\x00\x00')
+        elif t == 0x80:
+            pid = body[:2]
+            flen = struct.unpack('>H', body[2:4])[0]
+            filt = body[4:4 + flen].decode()
+            with self.lock:
+                self.subs.append((c, filt))
+                retained = [(k, v) for k, v in self.retained.items() if topic_matches(filt, k)]
+            c.sendall(b'\x90\x03' + pid + b'\x00')
+            for k, v in retained:
+                c.sendall(publish_packet(k, v, retain=True))
+        elif t == 0x30:
+            qos = (kind >> 1) & 3
+            tlen = struct.unpack('>H', body[:2])[0]
+            topic = body[2:2 + tlen].decode()
+            off = 2 + tlen + (2 if qos else 0)
+            with self.lock:
+                self.received.append((topic, body[off:], bool(kind & 1), qos))
+                if kind & 1:
+                    self.retained[topic] = body[off:]
+            if qos == 1 and self.ack_qos1:
+                c.sendall(b'\x40\x02' + body[2 + tlen:4 + tlen])
+        elif t == 0xC0:
+            c.sendall(b'\xd0\x00')
@@ -0,0 +1,119 @@
+// FleetStateIndex: apply() semantics, fleet and per-site counts, explicit sites
+
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "fleet_state_index.h"
+
+using garage::FleetStateIndex;
+using Q = FleetStateIndex::Query;
+
+namespace {
+
+void applyMessages() {
+    FleetStateIndex idx;
+    CHECK(idx.apply("a/door", "open"));
+    CHECK(!idx.apply("a/door", "open"));       // no change
+    CHECK(idx.apply("a/door/online", "true"));
+    CHECK(!idx.apply("a/door", "ajar"));       // unknown payload
+    CHECK(!idx.apply("a/door", "true"));       // online vocabulary on the door topic
+    CHECK(!idx.apply("a/window", "open"));     // not a door topic
+    CHECK(!idx.apply("/door", "open"));        // no device name
+    CHECK(idx.isOpen(0) && idx.isOnline(0));
+
+    // A cleared retained message resets the bit of a known device
+    uint64_t gen = idx.generation();
+    CHECK(idx.apply("a/door", ""));
+    CHECK(!idx.isOpen(0));
+    CHECK(idx.generation() > gen);
+
+    // ...and carries no state for a device never seen: nothing is interned
+    size_t devices = idx.deviceCount();
+    CHECK(!idx.apply("ghost/door/online", ""));
+    CHECK(idx.deviceCount() == devices);
+}
+
+void counts() {
+    FleetStateIndex idx;
+    idx.apply("a/door", "open");           // online, open
+    idx.apply("a/door/online", "true");
+    idx.apply("b/door", "open");           // offline (never reported online), open
+    idx.apply("c/door", "closed");         // online, closed
+    idx.apply("c/door/online", "true");
+    idx.apply("d/door/online", "false");   // offline, no door state
+    CHECK(idx.deviceCount() == 4);
+    CHECK(idx.count(Q::Open) == 2);
+    CHECK(idx.count(Q::Online) == 2);
+    CHECK(idx.count(Q::Offline) == 2);
+    CHECK(idx.count(Q::OnlineOpen) == 1);
+    CHECK(idx.count(Q::OfflineOpen) == 1);
+    CHECK(idx.devices(Q::Offline) == std::vector<uint32_t>({1, 3}));
+}
+
+// Enough devices for several bitset words; counts agree with a per-device tally
+void manyDevices() {
+    FleetStateIndex idx;
+    const uint32_t n = 1000;
+    size_t open = 0, online = 0, onlineOpen = 0, siteOpen = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        std::string site = i % 3 == 0 ? "north" : "south";
+        std::string dev = site + "/esp-" + std::to_string(i);
+        bool isOpen = i % 5 == 0;
+        bool isOnline = i % 7 != 0;
+        idx.apply(dev + "/door", isOpen ? "open" : "closed");
+        idx.apply(dev + "/door/online", isOnline ? "true" : "false");
+        open += isOpen;
+        online += isOnline;
+        onlineOpen += isOpen && isOnline;
+        siteOpen += isOpen && site == "north";
+    }
+    CHECK(idx.openBits().size() == (n + 63) / 64);
+    CHECK(idx.count(Q::Open) == open);
+    CHECK(idx.count(Q::Online) == online);
+    CHECK(idx.count(Q::Offline) == n - online);
+    CHECK(idx.count(Q::OnlineOpen) == onlineOpen);
+    CHECK(idx.count(Q::OfflineOpen) == open - onlineOpen);
+    CHECK(idx.countSite("north", Q::Open) == siteOpen);
+    CHECK(idx.countSite("north", Q::Open) + idx.countSite("south", Q::Open) == open);
+    CHECK(idx.countSite("north", Q::Offline) + idx.countSite("south", Q::Offline) == n - online);
+    CHECK(idx.devices(Q::Open).size() == open);
+}
+
+void sites() {
+    FleetStateIndex idx;
+    idx.apply("north/a/door", "open");   // site from the first topic level
+    idx.apply("b/door", "open");         // single level: no site
+    CHECK(idx.countSite("north", Q::Open) == 1);
+    CHECK(idx.countSite("b", Q::Open) == 0);
+    CHECK(idx.countSite("nowhere", Q::Open) == 0);
+
+    // setSite() assigns a site-less device and moves one that had a site
+    idx.setSite("b", "south");
+    CHECK(idx.countSite("south", Q::Open) == 1);
+    uint64_t gen = idx.generation();
+    idx.setSite("north/a", "south");
+    CHECK(idx.generation() > gen);
+    CHECK(idx.countSite("north", Q::Open) == 0);
+    CHECK(idx.countSite("south", Q::Open) == 2);
+    gen = idx.generation();
+    idx.setSite("north/a", "south");     // already there
+    CHECK(idx.generation() == gen);
+
+    // A device named only by setSite() is known, offline and belongs to the site
+    idx.setSite("c", "south");
+    CHECK(idx.deviceCount() == 3);
+    CHECK(idx.countSite("south", Q::Offline) == 3);
+    idx.apply("c/door/online", "true");
+    CHECK(idx.countSite("south", Q::Online) == 1);
+}
+
+} // namespace
+
+int main() {
+    applyMessages();
+    counts();
+    manyDevices();
+    sites();
+    return CHECK_DONE();
+}
@@ -0,0 +1,76 @@
+// InternTable: dense ids, growth across rehashes, collision probing, misses
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "intern_table.h"
+
+using garage::InternTable;
+
+namespace {
+
+void denseIds() {
+    InternTable t;
+    CHECK(t.size() == 0);
+    CHECK(t.find("a") == InternTable::NOT_FOUND);
+    CHECK(t.intern("a") == 0);
+    CHECK(t.intern("b") == 1);
+    CHECK(t.intern("a") == 0);
+    CHECK(t.intern("") == 2);  // the empty string is a key like any other
+    CHECK(t.find("") == 2);
+    CHECK(t.size() == 3);
+    CHECK(t.name(1) == "b");
+    CHECK(t.find("c") == InternTable::NOT_FOUND);
+    CHECK(t.size() == 3);  // find() never inserts
+}
+
+// Enough keys for many doublings from the initial single group
+void growth() {
+    const uint32_t n = 100000;
+    InternTable t;
+    for (uint32_t i = 0; i < n; ++i) {
+        CHECK(t.intern("esp-" + std::to_string(i)) == i);
+    }
+    CHECK(t.size() == n);
+    uint32_t wrong = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        std::string key = "esp-" + std::to_string(i);
+        if (t.find(key) != i || t.name(i) != key || t.find(key, InternTable::hash(key)) != i) ++wrong;
+        if (t.find("missing-" + std::to_string(i)) != InternTable::NOT_FOUND) ++wrong;
+    }
+    CHECK(wrong == 0);
+}
+
+// Identical full hashes: every key lands in the same group with the same tag, so lookups
+// depend on the string compare and on probing past full groups
+void collisions() {
+    const uint64_t h = 0x1234567890abcdefULL;
+    const uint32_t n = 100;  // several groups' worth, forces rehashes while colliding
+    InternTable t;
+    for (uint32_t i = 0; i < n; ++i) {
+        CHECK(t.intern("k" + std::to_string(i), h) == i);
+    }
+    for (uint32_t i = 0; i < n; ++i) {
+        CHECK(t.find("k" + std::to_string(i), h) == i);
+    }
+    CHECK(t.find("k" + std::to_string(n), h) == InternTable::NOT_FOUND);
+
+    // Same tag (low 7 bits) but different groups
+    InternTable u;
+    std::vector<uint64_t> hashes;
+    for (uint64_t g = 0; g < 64; ++g) hashes.push_back((g << 7) | 0x55);
+    for (size_t i = 0; i < hashes.size(); ++i) CHECK(u.intern("t" + std::to_string(i), hashes[i]) == i);
+    for (size_t i = 0; i < hashes.size(); ++i) CHECK(u.find("t" + std::to_string(i), hashes[i]) == i);
+    CHECK(u.find("t0", hashes[1]) == InternTable::NOT_FOUND);
+}
+
+} // namespace
+
+int main() {
+    denseIds();
+    growth();
+    collisions();
+    return CHECK_DONE();
+}
@@ -0,0 +1,124 @@
+// Packet encoders shared with the firmware: mqtt_packets.h (MQTT 3.1.1) and mqttsn_packets.h
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "../../esp8266/lib/mqtt_packets/mqtt_packets.h"
+#include "../../esp8266/lib/mqtt_packets/mqttsn_packets.h"
+#include "check.h"
+
+namespace {
+
+bool bytesEqual(const uint8_t* a, size_t n, std::vector<uint8_t> b) {
+    return n == b.size() && std::memcmp(a, b.data(), n) == 0;
+}
+
+void remainingLength() {
+    const size_t lengths[] = {0, 127, 128, 16383, 16384, 2097151, 2097152, 268435455};
+    const size_t sizes[] = {1, 1, 2, 2, 3, 3, 4, 4};
+    for (size_t i = 0; i < 8; ++i) {
+        uint8_t buf[5] = {mqttpkt::PUBLISH};
+        size_t n = mqttpkt::putRemainingLength(buf + 1, lengths[i]);
+        CHECK(n == sizes[i]);
+        CHECK(mqttpkt::remainingLengthSize(lengths[i]) == sizes[i]);
+        size_t decoded;
+        CHECK(mqttpkt::decodeHeader(buf, 1 + n, decoded) == int(1 + n));
+        CHECK(decoded == lengths[i]);
+        CHECK(mqttpkt::decodeHeader(buf, n, decoded) == 0);  // one byte short
+    }
+    const uint8_t tooLong[6] = {mqttpkt::PUBLISH, 0x80, 0x80, 0x80, 0x80, 0x01};
+    size_t decoded;
+    CHECK(mqttpkt::decodeHeader(tooLong, sizeof(tooLong), decoded) == -1);
+}
+
+void fixedPackets() {
+    static_assert(mqttpkt::Connack<true, 0>::bytes[2] == 1, "session present flag");
+    CHECK(bytesEqual(mqttpkt::Connack<false, 5>::bytes, 4, {0x20, 2, 0, 5}));
+    CHECK(bytesEqual(mqttpkt::PINGREQ_PACKET, 2, {0xC0, 0}));
+
+    uint8_t buf[8];
+    CHECK(bytesEqual(buf, mqttpkt::encodePuback(buf, 0x1234), {0x40, 2, 0x12, 0x34}));
+    CHECK(bytesEqual(buf, mqttpkt::encodeSuback<1>(buf, 0xBEEF), {0x90, 3, 0xBE, 0xEF, 1}));
+}
+
+void publish() {
+    static constexpr auto OPEN = mqttpkt::publishPacket("garage/door", "open", true);
+    static_assert(OPEN.size == 19, "2 header + 13 topic + 4 payload");
+    CHECK(bytesEqual(OPEN.bytes, OPEN.size,
+                     {0x31, 17, 0, 11, 'g', 'a', 'r', 'a', 'g', 'e', '/', 'd', 'o', 'o', 'r', 'o', 'p', 'e', 'n'}));
+
+    // The runtime encoders produce the same bytes as the constexpr packet
+    uint8_t buf[64];
+    size_t n = mqttpkt::encodePublish(buf, sizeof(buf), "garage/door", 11, "open", 4, true);
+    CHECK(n == OPEN.size && std::memcmp(buf, OPEN.bytes, n) == 0);
+    n = mqttpkt::encodePublish(buf, sizeof(buf), mqttpkt::topic("garage/door"), "open", 4, true);
+    CHECK(n == OPEN.size && std::memcmp(buf, OPEN.bytes, n) == 0);
+
+    CHECK(mqttpkt::encodePublish(buf, OPEN.size - 1, "garage/door", 11, "open", 4, true) == 0);
+
+    // QoS 1: packet ID after the topic
+    n = mqttpkt::encodePublish(buf, sizeof(buf), "a/b", 3, "on", 2, false, 0x1234);
+    CHECK(bytesEqual(buf, n, {0x32, 9, 0, 3, 'a', '/', 'b', 0x12, 0x34, 'o', 'n'}));
+
+    // Two-byte remaining length
+    std::vector<uint8_t> big(300, 'x');
+    std::vector<uint8_t> out(400);
+    n = mqttpkt::encodePublish(out.data(), out.size(), "t", 1, big.data(), big.size(), false);
+    CHECK(n == 1 + 2 + 3 + 300);
+    size_t remaining;
+    CHECK(mqttpkt::decodeHeader(out.data(), n, remaining) == 3 && remaining == 303);
+}
+
+void connectAndSubscribe() {
+    uint8_t buf[128];
+    size_t n = mqttpkt::encodeConnect(buf, sizeof(buf), "id", 60, true);
+    CHECK(bytesEqual(buf, n, {0x10, 14, 0, 4, 'M', 'Q', 'T', 'T', 4, 0x02, 0, 60, 0, 2, 'i', 'd'}));
+
+    n = mqttpkt::encodeConnect(buf, sizeof(buf), "id", 15, false, "u", "p", "w", "false", 1, true);
+    CHECK(n == 2 + 10 + 4 + 3 + 7 + 3 + 3);
+    CHECK(buf[9] == (0x80 | 0x40 | 0x20 | 0x08 | 0x04));
+    CHECK(buf[10] == 0 && buf[11] == 15);
+    CHECK(std::memcmp(buf + 16, "\0\1w\0\5false\0\1u\0\1p", 16) == 0);
+    CHECK(mqttpkt::encodeConnect(buf, n - 1, "id", 15, false, "u", "p", "w", "false", 1, true) == 0);
+
+    n = mqttpkt::encodeSubscribe(buf, sizeof(buf), 7, "+/door", 6, 0);
+    CHECK(bytesEqual(buf, n, {0x82, 11, 0, 7, 0, 6, '+', '/', 'd', 'o', 'o', 'r', 0}));
+    CHECK(mqttpkt::encodeSubscribe(buf, n - 1, 7, "+/door", 6, 0) == 0);
+}
+
+void mqttsnPublish() {
+    static constexpr auto OPEN = mqttsn::publishPredefined(1, "open", true);
+    CHECK(bytesEqual(OPEN.bytes, OPEN.size, {11, 0x0C, 0x71, 0, 1, 0, 0, 'o', 'p', 'e', 'n'}));
+
+    mqttsn::Publish p;
+    CHECK(mqttsn::parsePublish(OPEN.bytes, OPEN.size, p));
+    CHECK(p.topicId == 1 && p.flags == 0x71 && p.len == 4 && std::memcmp(p.data, "open", 4) == 0);
+
+    // Three-byte length form
+    std::vector<uint8_t> longForm = {1, 0, 13, 0x0C, 0x61, 0x01, 0x02, 0, 0, 'o', 'p', 'e', 'n'};
+    CHECK(mqttsn::parsePublish(longForm.data(), longForm.size(), p));
+    CHECK(p.topicId == 0x0102 && p.flags == 0x61 && p.len == 4);
+
+    // Length field disagreeing with the datagram, truncated, not a PUBLISH, empty
+    CHECK(!mqttsn::parsePublish(OPEN.bytes, OPEN.size - 1, p));
+    std::vector<uint8_t> other(OPEN.bytes, OPEN.bytes + OPEN.size);
+    other[1] = 0x04;
+    CHECK(!mqttsn::parsePublish(other.data(), other.size(), p));
+    const uint8_t tiny[3] = {3, 0x0C, 0x60};
+    CHECK(!mqttsn::parsePublish(tiny, sizeof(tiny), p));
+    CHECK(!mqttsn::parsePublish(tiny, 0, p));
+    const uint8_t shortLong[2] = {1, 0};
+    CHECK(!mqttsn::parsePublish(shortLong, sizeof(shortLong), p));
+}
+
+} // namespace
+
+int main() {
+    remainingLength();
+    fixedPackets();
+    publish();
+    connectAndSubscribe();
+    mqttsnPublish();
+    return CHECK_DONE();
+}
@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+"""mqttsn_gateway: forwarding, conflation while the broker is down, source filtering, publishes
+still in the send queue when the connection drops.
+
+Usage: mqttsn_gateway_test.py <path to mqttsn_gateway>
+"""
+import os
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+
+from fake_broker import FakeBroker
+
+STATUS, ONLINE, FLOOD = 1, 2, 3
+
+
+def datagram(topic_id, payload, retain=True):
+    flags = 0x60 | (0x10 if retain else 0) | 0x01
+    return bytes([7 + len(payload), 0x0C, flags, topic_id >> 8, topic_id & 0xFF, 0, 0]) + payload
+
+
+def free_udp_port():
+    s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    s.bind(('127.0.0.1', 0))
+    port = s.getsockname()[1]
+    s.close()
+    return port
+
+
+def loopback_buffering():
+    """Bytes a loopback TCP connection takes before send() blocks while the peer never reads."""
+    server = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    server.bind(('127.0.0.1', 0))
+    server.listen(1)
+    c = socket.create_connection(server.getsockname())
+    s, _ = server.accept()
+    c.setblocking(False)
+    total, stalls = 0, 0
+    while stalls < 20:
+        try:
+            total += c.send(b'x' * 4096)
+            stalls = 0
+        except BlockingIOError:
+            stalls += 1
+            time.sleep(0.01)
+    for x in (c, s, server):
+        x.close()
+    return total
+
+
+def main():
+    binary = sys.argv[1]
+    failures = []
+
+    def check(name, ok):
+        if not ok:
+            failures.append(name)
+            print('FAIL', name)
+
+    with tempfile.TemporaryDirectory() as tmp:
+        topics = os.path.join(tmp, 'topics.txt')
+        with open(topics, 'w') as f:
+            f.write('# id topic\n1 garage/door\n2 garage/door/online\n3 garage/flood\n')
+
+        broker = FakeBroker()
+        broker.stop()  # keep the port, refuse connections for now
+        udp_port, denied_port = free_udp_port(), free_udp_port()
+        procs = [
+            subprocess.Popen([binary, '--topics', topics, '--port', str(udp_port), '--broker-port',
+                              str(broker.port), '--allow', '127.0.0.1']),
+            subprocess.Popen([binary, '--topics', topics, '--port', str(denied_port), '--broker-port',
+                              str(broker.port), '--allow', '10.0.0.0/8']),
+        ]
+        try:
+            time.sleep(0.3)
+            u = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+
+            def send(d, port=udp_port):
+                u.sendto(d, ('127.0.0.1', port))
+
+            # Broker down: the newest value per topic ID is kept
+            send(datagram(ONLINE, b'true'))
+            send(datagram(STATUS, b'open'))
+            send(datagram(STATUS, b'closed'))
+            send(datagram(9, b'x'))                  # unknown topic ID
+            send(b'\x05\x0c\x60\x00')                # malformed
+            send(datagram(STATUS, b'open'), denied_port)
+            time.sleep(0.3)
+
+            broker.start()
+            check('pending delivered after reconnect',
+                  broker.wait_for(lambda: len(broker.messages()) >= 2))
+            time.sleep(0.3)
+            got = {(t, p, r) for t, p, r, _ in broker.messages()}
+            check('pending conflated to newest, retained',
+                  got == {('garage/door', b'closed', True), ('garage/door/online', b'true', True)})
+
+            # Connected: forwarded as it arrives, retain flag kept
+            send(datagram(STATUS, b'open'))
+            send(datagram(STATUS, b'closed', retain=False))
+            check('live forward', broker.wait_for(lambda: len(broker.messages()) == 4))
+            check('live order and flags', broker.messages()[2:] ==
+                  [('garage/door', b'open', True, 0), ('garage/door', b'closed', False, 0)])
+
+            # The --allow 10.0.0.0/8 gateway never forwards our 127.0.0.1 datagrams
+            send(datagram(STATUS, b'open'), denied_port)
+            time.sleep(1.5)
+            check('disallowed source dropped', len(broker.messages()) == 4)
+
+            # Broker stops reading: once the socket buffers are full the gateway's writes wait in
+            # its send queue (under the 1 MiB limit). The connection then drops, taking the queue
+            # with it; those publishes must still be pending and go out after the reconnect
+            broker.hang()
+            payload = b'f' * 240
+            publish_size = 4 + len('garage/flood') + len(payload)
+            for i in range((loopback_buffering() + (256 << 10)) // publish_size):
+                send(datagram(FLOOD, payload))
+                if i % 32 == 31:
+                    time.sleep(0.002)  # stay within the gateway's UDP receive buffer
+            send(datagram(STATUS, b'last'))
+            time.sleep(0.5)
+            broker.stop()
+            broker.start()
+            check('queued publishes delivered after reconnect',
+                  broker.wait_for(lambda: ('garage/door', b'last', True, 0) in broker.messages()))
+        finally:
+            for p in procs:
+                p.kill()
+                p.wait()
+            broker.stop()
+
+    return 1 if failures else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+"""status_server: snapshots from retained state, ETag/If-None-Match and 304, pipelining,
+Connection: close, and HTTP staying responsive while the broker never answers CONNECT.
+
+Usage: status_server_test.py <path to status_server>
+"""
+import json
+import socket
+import subprocess
+import sys
+import time
+
+from fake_broker import FakeBroker
+
+
+def free_tcp_port():
+    s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    s.bind(('127.0.0.1', 0))
+    port = s.getsockname()[1]
+    s.close()
+    return port
+
+
+class Http:
+    """One keep-alive connection; responses are parsed as (status, headers, body)."""
+
+    def __init__(self, port):
+        self.sock = socket.create_connection(('127.0.0.1', port), timeout=5)
+        self.buf = b''
+
+    def send(self, *requests):
+        self.sock.sendall(b''.join(requests))
+
+    def response(self):
+        while b'\r\n\r\n' not in self.buf:
+            data = self.sock.recv(65536)
+            if not data:
+                return None
+            self.buf += data
+        head, self.buf = self.buf.split(b'\r\n\r\n', 1)
+        lines = head.decode().split('\r\n')
+        status = int(lines[0].split()[1])
+        headers = {k.strip().lower(): v.strip() for k, v in (l.split(':', 1) for l in lines[1:])}
+        length = 0 if status == 304 else int(headers.get('content-length', 0))
+        while len(self.buf) < length:
+            self.buf += self.sock.recv(65536)
+        body, self.buf = self.buf[:length], self.buf[length:]
+        return status, headers, body
+
+    def closed(self):
+        try:
+            return self.sock.recv(1) == b''
+        except OSError:
+            return True
+
+
+def get(path, *headers):
+    return ('GET %s HTTP/1.1\r\nHost: x\r\n%s\r\n' % (path, ''.join(h + '\r\n' for h in headers))).encode()
+
+
+def main():
+    binary = sys.argv[1]
+    failures = []
+
+    def check(name, ok):
+        if not ok:
+            failures.append(name)
+            print('FAIL', name)
+
+    broker = FakeBroker()
+    silent = FakeBroker()
+    silent.hang()  # accepts connections, never sends CONNACK
+    broker.publish('a/door', b'open', retain=True)
+    broker.publish('a/door/online', b'true', retain=True)
+    broker.publish('b/door', b'closed', retain=True)
+
+    port, silent_port = free_tcp_port(), free_tcp_port()
+    procs = [subprocess.Popen([binary, '--port', str(port), '--broker-port', str(broker.port)]),
+             subprocess.Popen([binary, '--port', str(silent_port), '--broker-port', str(silent.port)])]
+    try:
+        check('subscribed', broker.wait_for(lambda: len(broker.subs) == 2))
+
+        def status():
+            c = Http(port)
+            c.send(get('/status'))
+            return c.response()
+
+        check('retained state applied',
+              broker.wait_for(lambda: json.loads(status()[2])['counts']['open'] == 1))
+        code, headers, body = status()
+        doc = json.loads(body)
+        check('200 json', code == 200 and headers['content-type'] == 'application/json')
+        check('devices', [(d['id'], d['open'], d['online']) for d in doc['devices']] ==
+              [('a', True, True), ('b', False, False)])
+        etag = headers['etag']
+
+        # If-None-Match: exact, weak, in a list, "*" -> 304; anything else -> 200
+        c = Http(port)
+        for value, expect in ((etag, 304), ('W/' + etag, 304), ('"nope", ' + etag, 304), ('*', 304),
+                              ('"nope"', 200), (etag[:-2] + '"', 200)):
+            c.send(get('/status', 'If-None-Match: ' + value))
+            r = c.response()
+            check('If-None-Match %s -> %d' % (value, expect), r[0] == expect and r[1]['etag'] == etag)
+            if expect == 304:
+                check('304 has no body', r[2] == b'')
+
+        # Binary snapshot has its own ETag
+        c.send(get('/status.bin'))
+        code, headers, body = c.response()
+        check('binary', code == 200 and body[:4] == b'GDS1' and headers['etag'] != etag)
+
+        # Pipelined requests in one write are answered in order on the same connection
+        c.send(get('/status', 'If-None-Match: ' + etag), get('/missing'),
+               b'POST /status HTTP/1.1\r\nContent-Length: 0\r\n\r\n', get('/status.bin'))
+        codes = [c.response()[0] for _ in range(4)]
+        check('pipelined responses in order', codes == [304, 404, 405, 200])
+
+        # A state change moves the ETag
+        broker.publish('b/door', b'open', retain=True)
+        check('new ETag after change', broker.wait_for(lambda: status()[1]['etag'] != etag))
+        c.send(get('/status', 'If-None-Match: ' + etag))
+        check('stale ETag gets 200', c.response()[0] == 200)
+
+        # Connection: close and HTTP/1.0 end the connection after the response
+        c.send(get('/status', 'Connection: close'))
+        check('Connection: close answered', c.response()[0] == 200)
+        check('Connection: close closes', c.closed())
+        c = Http(port)
+        c.send(b'GET /status HTTP/1.0\r\n\r\n')
+        check('HTTP/1.0 answered', c.response()[0] == 200)
+        check('HTTP/1.0 closes', c.closed())
+
+        # Broker accepts TCP but never answers CONNECT: HTTP is served without waiting for it,
+        # across more than one 5 s connect timeout and retry
+        slowest = 0.0
+        deadline = time.time() + 7
+        while time.time() < deadline:
+            start = time.time()
+            c = Http(silent_port)
+            c.send(get('/status'))
+            r = c.response()
+            slowest = max(slowest, time.time() - start)
+            check('served while connecting', r is not None and r[0] == 200)
+            time.sleep(0.05)
+        check('no stall while connecting (slowest %.3f s)' % slowest, slowest < 0.5)
+    finally:
+        for p in procs:
+            p.kill()
+            p.wait()
+        broker.stop()
+        silent.stop()
+
+    return 1 if failures else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
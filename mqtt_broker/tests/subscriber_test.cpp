@@ -0,0 +1,260 @@
+// Subscriber over a socketpair: packet framing across reads, buffer growth, malformed input,
+// QoS 1 PUBACKs, conflation, keep-alive PINGREQ/PINGRESP deadline, the send queue
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../esp8266/lib/mqtt_packets/mqtt_packets.h"
+#include "check.h"
+#include "subscriber.h"
+
+using garage::Message;
+using garage::Subscriber;
+
+namespace {
+
+struct Received {
+    std::string topic;
+    std::string payload;
+    uint8_t qos;
+    bool retained;
+};
+
+// A Subscriber attached to one end of a socketpair; the test plays the broker on the other
+struct Pair {
+    explicit Pair(size_t bufferSize = 256 * 1024, uint16_t keepAliveSec = 0) : sub("test", bufferSize) {
+        int fds[2];
+        CHECK(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == 0);
+        sub.attach(fds[0], keepAliveSec);
+        peer = fds[1];
+        fcntl(peer, F_SETFL, O_NONBLOCK);
+    }
+    ~Pair() { ::close(peer); }
+
+    void write(const std::vector<uint8_t>& bytes) { CHECK(::send(peer, bytes.data(), bytes.size(), 0) == ssize_t(bytes.size())); }
+
+    std::vector<uint8_t> read() {
+        std::vector<uint8_t> out(65536);
+        ssize_t n = ::recv(peer, out.data(), out.size(), 0);
+        out.resize(n > 0 ? size_t(n) : 0);
+        return out;
+    }
+
+    bool poll(int timeoutMs = 100) {
+        return sub.poll(timeoutMs, [this](const Message* m, size_t n) {
+            ++batches;
+            for (size_t i = 0; i < n; ++i) {
+                got.push_back(Received{std::string(m[i].topic), std::string(m[i].payload), m[i].qos, m[i].retained});
+            }
+        });
+    }
+
+    Subscriber sub;
+    int peer;
+    size_t batches = 0;
+    std::vector<Received> got;
+};
+
+std::vector<uint8_t> publish(const std::string& topic, const std::string& payload, bool retain = false,
+                             uint16_t packetId = 0) {
+    std::vector<uint8_t> out(16 + topic.size() + payload.size());
+    out.resize(mqttpkt::encodePublish(out.data(), out.size(), topic.data(), topic.size(), payload.data(),
+                                      payload.size(), retain, packetId));
+    return out;
+}
+
+std::vector<uint8_t> concat(std::vector<uint8_t> a, const std::vector<uint8_t>& b) {
+    a.insert(a.end(), b.begin(), b.end());
+    return a;
+}
+
+void sleepMs(int ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+// Packets split at arbitrary points arrive whole; everything complete in one read is one batch
+void splitAcrossReads() {
+    Pair p;
+    std::vector<uint8_t> bytes = concat(publish("a/door", "open", true), publish("b/door", "closed"));
+    p.write(std::vector<uint8_t>(bytes.begin(), bytes.begin() + 5));
+    CHECK(p.poll());
+    CHECK(p.got.empty() && p.batches == 0);
+    p.write(std::vector<uint8_t>(bytes.begin() + 5, bytes.end()));
+    CHECK(p.poll());
+    CHECK(p.batches == 1 && p.got.size() == 2);
+    CHECK(p.got[0].topic == "a/door" && p.got[0].payload == "open" && p.got[0].retained && p.got[0].qos == 0);
+    CHECK(p.got[1].topic == "b/door" && p.got[1].payload == "closed" && !p.got[1].retained);
+
+    // A whole packet plus the head of the next: the first is delivered, the tail is kept
+    bytes = concat(publish("c/door", "open"), publish("d/door", "open"));
+    p.write(std::vector<uint8_t>(bytes.begin(), bytes.end() - 3));
+    CHECK(p.poll());
+    CHECK(p.got.size() == 3 && p.got[2].topic == "c/door");
+    p.write(std::vector<uint8_t>(bytes.end() - 3, bytes.end()));
+    CHECK(p.poll());
+    CHECK(p.got.size() == 4 && p.got[3].topic == "d/door" && p.got[3].payload == "open");
+}
+
+// A packet larger than the initial buffer grows it instead of failing
+void bufferGrowth() {
+    Pair p(64);
+    CHECK(p.sub.memoryBytes() < 64);  // no receive buffer before data arrives
+    std::string big(1000, 'x');
+    p.write(publish("big/door", big));
+    for (int i = 0; i < 10 && p.got.empty(); ++i) CHECK(p.poll());
+    CHECK(p.got.size() == 1 && p.got[0].payload == big);
+    CHECK(p.sub.memoryBytes() >= 1024);
+    CHECK(p.sub.connected());
+}
+
+void malformed() {
+    {
+        Pair p;  // remaining length longer than four bytes
+        p.write({mqttpkt::PUBLISH, 0x80, 0x80, 0x80, 0x80, 0x01});
+        CHECK(!p.poll());
+        CHECK(!p.sub.connected());
+    }
+    {
+        Pair p;  // topic length past the end of the packet
+        p.write({mqttpkt::PUBLISH, 3, 0, 9, 'a'});
+        CHECK(!p.poll());
+    }
+    {
+        Pair p;  // QoS 2 is never subscribed to
+        p.write({mqttpkt::PUBLISH | 0x04, 5, 0, 1, 'a', 0, 1});
+        CHECK(!p.poll());
+    }
+    {
+        Pair p;  // a packet type a subscriber never receives
+        p.write({mqttpkt::CONNACK, 2, 0, 0});
+        CHECK(!p.poll());
+    }
+    {
+        Pair p;  // peer closed
+        ::shutdown(p.peer, SHUT_WR);
+        CHECK(!p.poll());
+    }
+}
+
+// QoS 1 PUBLISH is acknowledged with its packet ID; PUBACKs from the broker reach the ack handler
+void qos1() {
+    Pair p;
+    p.write(concat(publish("a/door", "open", true, 0x1234), publish("b/door", "open", false, 0x0102)));
+    CHECK(p.poll());
+    CHECK(p.got.size() == 2 && p.got[0].qos == 1 && p.got[0].payload == "open");
+    CHECK(p.read() == std::vector<uint8_t>({0x40, 2, 0x12, 0x34, 0x40, 2, 0x01, 0x02}));
+
+    std::vector<uint16_t> acked;
+    p.sub.setAckHandler([&](uint16_t id) { acked.push_back(id); });
+    p.write({0x40, 2, 0, 7, 0x40, 2, 0x01, 0x00});
+    CHECK(p.poll());
+    CHECK(acked == std::vector<uint16_t>({7, 256}));
+}
+
+// Conflation keeps the newest message per topic within a batch, in the order those newest
+// messages arrived; every QoS 1 message is still acknowledged, including the dropped ones
+void conflation() {
+    Pair p;
+    p.sub.setConflate(true);
+    std::vector<uint8_t> bytes;
+    bytes = concat(bytes, publish("a/door", "open", true, 1));
+    bytes = concat(bytes, publish("b/door", "open", true));
+    bytes = concat(bytes, publish("a/door", "closed", true, 2));
+    bytes = concat(bytes, publish("c/door", "open", true));
+    bytes = concat(bytes, publish("b/door", "closed", true));
+    bytes = concat(bytes, publish("a/door", "open", true, 3));
+    p.write(bytes);
+    CHECK(p.poll());
+    CHECK(p.batches == 1 && p.got.size() == 3);
+    if (p.got.size() == 3) {
+        CHECK(p.got[0].topic == "c/door" && p.got[0].payload == "open");
+        CHECK(p.got[1].topic == "b/door" && p.got[1].payload == "closed");
+        CHECK(p.got[2].topic == "a/door" && p.got[2].payload == "open" && p.got[2].qos == 1);
+    }
+    CHECK(p.read() == std::vector<uint8_t>({0x40, 2, 0, 1, 0x40, 2, 0, 2, 0x40, 2, 0, 3}));
+
+    // Separate reads are separate batches: nothing is held back across them
+    p.write(publish("a/door", "closed", true));
+    CHECK(p.poll());
+    p.write(publish("a/door", "open", true));
+    CHECK(p.poll());
+    CHECK(p.batches == 3 && p.got.size() == 5 && p.got[3].payload == "closed" && p.got[4].payload == "open");
+}
+
+// PINGREQ after half the keep-alive without traffic in either direction; no PINGRESP within
+// 1.5x the keep-alive of the last received byte closes the connection
+void keepAlive() {
+    Pair p(256 * 1024, 1);
+    CHECK(p.poll(0));
+    CHECK(p.read().empty());  // fresh connection: nothing to send yet
+
+    sleepMs(600);
+    CHECK(p.poll(0));
+    CHECK(p.read() == std::vector<uint8_t>({0xC0, 0}));
+    p.write({0xD0, 0});
+    CHECK(p.poll());
+    auto pingResp = std::chrono::steady_clock::now();
+
+    // Sending alone does not hold off the PINGREQ: only a reply proves the broker is still there
+    std::vector<uint8_t> sent;
+    const std::vector<uint8_t> puback = {0x40, 2, 0, 1};
+    for (int i = 0; i < 7; ++i) {
+        CHECK(p.sub.sendPackets(puback.data(), puback.size()));
+        CHECK(p.poll(0));
+        sleepMs(100);
+        std::vector<uint8_t> r = p.read();
+        sent.insert(sent.end(), r.begin(), r.end());
+    }
+    const uint8_t ping[2] = {0xC0, 0};
+    CHECK(std::search(sent.begin(), sent.end(), ping, ping + 2) != sent.end());
+
+    // No answer: still open 1.3s after the PINGRESP, closed by 1.7s
+    std::this_thread::sleep_until(pingResp + std::chrono::milliseconds(1300));
+    CHECK(p.poll(0));
+    std::this_thread::sleep_until(pingResp + std::chrono::milliseconds(1700));
+    CHECK(!p.poll(0));
+    CHECK(!p.sub.connected());
+}
+
+// Bytes the socket does not take are queued and flushed by poll(), in order; past the
+// send-queue limit sendPackets() fails
+void sendQueue() {
+    Pair p;
+    std::vector<uint8_t> data(1 << 20);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = uint8_t(i * 7);
+    CHECK(p.sub.sendPackets(data.data(), data.size()));
+    size_t queued = p.sub.queuedBytes();
+    CHECK(queued > 0);
+    CHECK(!p.sub.sendPackets(data.data(), data.size() - queued + 1));
+
+    std::vector<uint8_t> out;
+    for (int i = 0; i < 1000 && out.size() < data.size(); ++i) {
+        std::vector<uint8_t> r = p.read();
+        out.insert(out.end(), r.begin(), r.end());
+        CHECK(p.poll(1));
+    }
+    CHECK(p.sub.queuedBytes() == 0);
+    CHECK(out == data);
+}
+
+} // namespace
+
+int main() {
+    splitAcrossReads();
+    bufferGrowth();
+    malformed();
+    qos1();
+    conflation();
+    keepAlive();
+    sendQueue();
+    return CHECK_DONE();
+}
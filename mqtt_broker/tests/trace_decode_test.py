@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+"""trace_decode: timestamps across micros() wraps, including gaps longer than 256 wraps;
+signed event arguments.
+
+Usage: trace_decode_test.py <path to trace_decode>
+"""
+import os
+import struct
+import subprocess
+import sys
+import tempfile
+
+BOOT, DOOR_CHANGE, MQTT_FAILED, EPOCH = 0, 1, 7, 13
+
+
+def record(now_us, event, arg=0):
+    return struct.pack('<IBBH', now_us & 0xFFFFFFFF, event, (now_us >> 32) & 0xFF, arg)
+
+
+def dump(records):
+    return b'GTR2' + struct.pack('<HHII', len(records), 8, 0, 0) + b''.join(records)
+
+
+def decode(binary, data):
+    with tempfile.NamedTemporaryFile(delete=False) as f:
+        f.write(data)
+    try:
+        return subprocess.run([binary, f.name], check=True, capture_output=True, text=True).stdout
+    finally:
+        os.unlink(f.name)
+
+
+def decoded_seconds(binary, data):
+    return [float(line.split()[0]) for line in decode(binary, data).splitlines()[1:]]
+
+
+def main():
+    binary = sys.argv[1]
+    failures = 0
+
+    def check(name, got, want):
+        nonlocal failures
+        if any(abs(g - w) > 1e-6 for g, w in zip(got, want)) or len(got) != len(want):
+            print(f'{name}: got {got}, want {want}')
+            failures += 1
+
+    # Two hours apart: one wrap, the low word goes backwards
+    start = 5 * 3600 * 10**6
+    t1 = start + 2 * 3600 * 10**6
+    check('2h gap', decoded_seconds(binary, dump([record(start, BOOT), record(t1, DOOR_CHANGE, 1)])),
+          [0.0, 7200.0])
+
+    # Three hours with the low word ending above the start: the old backwards-step rule missed this
+    t2 = start + 3 * (1 << 32) + 1000
+    check('3 wraps', decoded_seconds(binary, dump([record(start, BOOT), record(t2, DOOR_CHANGE)])),
+          [0.0, (t2 - start) / 1e6])
+
+    # Twenty days: the firmware inserts EPOCH with the skipped multiples of 256 wraps
+    t3 = t1 + 20 * 86400 * 10**6
+    skipped = ((t3 >> 32) - (t1 >> 32)) >> 8
+    check('20 days', decoded_seconds(binary, dump([record(start, BOOT), record(t1, DOOR_CHANGE),
+                                                   record(t3, EPOCH, skipped), record(t3, DOOR_CHANGE)])),
+          [0.0, (t1 - start) / 1e6, (t3 - start) / 1e6, (t3 - start) / 1e6])
+
+    # PubSubClient's negative states (-4..-1) are stored as uint16_t and printed signed
+    lines = decode(binary, dump([record(start, MQTT_FAILED, (-2) & 0xFFFF),
+                                 record(start, MQTT_FAILED, 5)])).splitlines()[1:]
+    args = [int(line.split()[3]) for line in lines]
+    if args != [-2, 5]:
+        print(f'signed arg: got {args}, want [-2, 5]')
+        failures += 1
+
+    return 1 if failures else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
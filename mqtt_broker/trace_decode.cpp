@@ -0,0 +1,173 @@
+// Decoder for firmware trace dumps (esp8266/lib/trace)
+// - Input: a raw dump (MQTT payload of garage/door/trace) or a serial log with "TRACE <hex>" lines
+// - Prints a timeline per dump; --chrome writes a Chrome trace JSON (chrome://tracing, Perfetto)
+//
+// Usage: trace_decode <file> [--chrome out.json]
+
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../esp8266/lib/trace/trace_format.h"
+
+namespace {
+
+struct EventInfo {
+    const char* name;
+    const char* arg;
+};
+
+const EventInfo EVENTS[] = {
+#define TRACE_INFO(name, arg) {#name, arg},
+    TRACE_EVENTS(TRACE_INFO)
+#undef TRACE_INFO
+};
+
+struct Event {
+    uint64_t us;  // unwrapped, relative to the first record of the dump
+    uint16_t id;
+    int32_t arg;  // sign-extended for isSignedArg() events
+};
+
+struct Dump {
+    TraceHeader header;
+    std::vector<Event> events;
+};
+
+// Events whose arg is a duration in ms ending at the event; drawn as spans in the Chrome trace
+bool isSpanEnd(uint16_t id) {
+    return id == TRACE_WIFI_CONNECTED || id == TRACE_WIFI_FAILED || id == TRACE_MQTT_CONNECTED;
+}
+
+// Events whose arg is an int16_t stored in the record's uint16_t, e.g. PubSubClient's -4..-1 states
+bool isSignedArg(uint16_t id) {
+    return id == TRACE_MQTT_FAILED;
+}
+
+const char* eventName(uint16_t id) {
+    return id < TRACE_EVENT_COUNT ? EVENTS[id].name : "UNKNOWN";
+}
+
+bool parseDump(const std::string& bytes, Dump& out) {
+    if (bytes.size() < sizeof(TraceHeader)) return false;
+    std::memcpy(&out.header, bytes.data(), sizeof(TraceHeader));
+    if (std::memcmp(out.header.magic, "GTR2", 4) != 0 || out.header.recordSize != sizeof(TraceRecord)) return false;
+    if (bytes.size() < sizeof(TraceHeader) + size_t(out.header.count) * sizeof(TraceRecord)) return false;
+
+    // Records carry the low 8 bits of the micros() wrap count; the forward distance between
+    // consecutive wrap bytes is exact below 256 wraps, and EPOCH records add the multiples of 256
+    uint64_t wraps = 0;
+    uint8_t prevWrap = 0;
+    uint64_t first = 0;
+    for (uint16_t i = 0; i < out.header.count; ++i) {
+        TraceRecord r;
+        std::memcpy(&r, bytes.data() + sizeof(TraceHeader) + i * sizeof(TraceRecord), sizeof(r));
+        wraps = i == 0 ? r.wrap : wraps + uint8_t(r.wrap - prevWrap);
+        if (r.event == TRACE_EPOCH) wraps += uint64_t(r.arg) << 8;
+        prevWrap = r.wrap;
+        uint64_t us = (wraps << 32) | r.timestampUs;
+        if (i == 0) first = us;
+        int32_t arg = isSignedArg(r.event) ? int32_t(int16_t(r.arg)) : int32_t(r.arg);
+        out.events.push_back(Event{us - first, r.event, arg});
+    }
+    return true;
+}
+
+// Empty result for malformed input (e.g. a line cut short by a serial glitch)
+std::string fromHex(const std::string& hex) {
+    if (hex.size() % 2 != 0) return {};
+    std::string out;
+    for (size_t i = 0; i < hex.size(); i += 2) {
+        if (!std::isxdigit(static_cast<unsigned char>(hex[i])) ||
+            !std::isxdigit(static_cast<unsigned char>(hex[i + 1]))) {
+            return {};
+        }
+        out.push_back(static_cast<char>(std::stoi(hex.substr(i, 2), nullptr, 16)));
+    }
+    return out;
+}
+
+std::vector<Dump> readDumps(const std::string& data) {
+    std::vector<Dump> dumps;
+    if (data.compare(0, 4, "GTR2") == 0) {
+        Dump d;
+        if (parseDump(data, d)) dumps.push_back(d);
+        return dumps;
+    }
+    std::istringstream in(data);
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t at = line.find("TRACE ");
+        if (at == std::string::npos) continue;
+        std::string hex = line.substr(at + 6);
+        while (!hex.empty() && (hex.back() == '\r' || hex.back() == ' ')) hex.pop_back();
+        Dump d;
+        if (parseDump(fromHex(hex), d)) dumps.push_back(d);
+    }
+    return dumps;
+}
+
+void printTimeline(const Dump& d, size_t index) {
+    std::printf("dump %zu: %u records, %u dropped\n", index, d.header.count, d.header.dropped);
+    for (const Event& e : d.events) {
+        std::printf("  %12.6f s  ", e.us / 1e6);
+        if (e.id < TRACE_EVENT_COUNT && EVENTS[e.id].arg[0]) {
+            std::printf("%-16s %d  (%s)\n", eventName(e.id), e.arg, EVENTS[e.id].arg);
+        } else {
+            std::printf("%s\n", eventName(e.id));
+        }
+    }
+}
+
+void writeChrome(const std::vector<Dump>& dumps, const char* path) {
+    std::ofstream out(path);
+    out << "{\"traceEvents\":[";
+    bool firstEvent = true;
+    for (size_t i = 0; i < dumps.size(); ++i) {
+        for (const Event& e : dumps[i].events) {
+            if (!firstEvent) out << ",";
+            firstEvent = false;
+            // One pid per dump so separate dumps do not overlap on the timeline
+            out << "{\"name\":\"" << eventName(e.id) << "\",\"pid\":" << i + 1 << ",\"tid\":1";
+            if (isSpanEnd(e.id)) {
+                uint64_t dur = uint64_t(e.arg) * 1000;
+                uint64_t start = e.us > dur ? e.us - dur : 0;
+                out << ",\"ph\":\"X\",\"ts\":" << start << ",\"dur\":" << e.us - start;
+            } else {
+                out << ",\"ph\":\"i\",\"s\":\"t\",\"ts\":" << e.us;
+            }
+            out << ",\"args\":{\"arg\":" << e.arg << "}}";
+        }
+    }
+    out << "]}\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc != 2 && !(argc == 4 && std::strcmp(argv[2], "--chrome") == 0)) {
+        std::fprintf(stderr, "usage: %s <file> [--chrome out.json]\n", argv[0]);
+        return 2;
+    }
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in) {
+        std::fprintf(stderr, "cannot open %s\n", argv[1]);
+        return 1;
+    }
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    std::vector<Dump> dumps = readDumps(data);
+    if (dumps.empty()) {
+        std::fprintf(stderr, "no trace dumps found in %s\n", argv[1]);
+        return 1;
+    }
+    for (size_t i = 0; i < dumps.size(); ++i) printTimeline(dumps[i], i);
+    if (argc == 4) writeChrome(dumps, argv[3]);
+    return 0;
+}